@@ -0,0 +1,606 @@
+#include <spool.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//a standalone harness, run with --help for options. Results go to stdout as json, progress to stderr
+
+namespace
+{
+	using bench_clock = std::chrono::steady_clock;
+
+	struct config
+	{
+		unsigned int threads;
+		double scale;
+	};
+
+	struct measurement
+	{
+		//how many operations the timed region performed
+		uint64_t ops;
+		std::chrono::nanoseconds elapsed;
+	};
+
+	struct bench_case
+	{
+		std::string name;
+		std::function<measurement(const config&)> run;
+	};
+
+	struct result
+	{
+		std::string name;
+		unsigned int threads;
+		uint64_t ops;
+		std::vector<double> ns_per_op;
+	};
+
+	size_t scaled(size_t n, const config& cfg)
+	{
+		return std::max<size_t>(1, static_cast<size_t>(n * cfg.scale));
+	}
+
+	void wait_for(const std::shared_ptr<spool::job>& j)
+	{
+		while (!j->is_done())
+		{
+		}
+	}
+
+	template<typename F>
+	measurement time(uint64_t ops, F&& body)
+	{
+		const auto start = bench_clock::now();
+		body();
+		return { ops, bench_clock::now() - start };
+	}
+
+#pragma region spool_cases
+
+	measurement empty_jobs_local(const config& cfg)
+	{
+		//submitted from inside a worker, so they go through the work stealing queues
+		spool::thread_pool pool(cfg.threads);
+		const size_t n = scaled(1'000'000, cfg);
+		std::atomic_size_t remaining = n;
+		return time(n, [&]()
+			{
+				pool.enqueue_job([&]()
+					{
+						auto& p = *spool::thread_pool::get_execution_context().pool;
+						for (size_t i = 0; i < n; i++)
+						{
+							p.enqueue_job([&]() {remaining.fetch_sub(1, std::memory_order_relaxed); });
+						}
+					});
+				while (remaining.load(std::memory_order_relaxed) != 0)
+				{
+				}
+			});
+	}
+
+	measurement empty_jobs_external(const config& cfg)
+	{
+		//submitted from a non-worker thread, so they all go through the unassigned queue
+		spool::thread_pool pool(cfg.threads);
+		const size_t n = scaled(1'000'000, cfg);
+		std::atomic_size_t remaining = n;
+		return time(n, [&]()
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					pool.enqueue_job([&]() {remaining.fetch_sub(1, std::memory_order_relaxed); });
+				}
+				while (remaining.load(std::memory_order_relaxed) != 0)
+				{
+				}
+			});
+	}
+
+	//a job only covers its own body, not the children it spawns, so each call's result is combined by whichever child finishes last
+	struct fib_frame
+	{
+		fib_frame* parent;
+		size_t slot;
+		std::atomic_int pending = 2;
+		std::array<uint64_t, 2> parts{};
+	};
+
+	void fib_complete(fib_frame* frame, size_t slot, uint64_t value, uint64_t* out, std::atomic_flag* finished)
+	{
+		while (frame != nullptr)
+		{
+			frame->parts[slot] = value;
+			if (frame->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			{
+				return;
+			}
+			value = frame->parts[0] + frame->parts[1];
+			slot = frame->slot;
+			fib_frame* parent = frame->parent;
+			delete frame;
+			frame = parent;
+		}
+		*out = value;
+		finished->test_and_set();
+	}
+
+	void fib_job(spool::thread_pool& pool, int n, fib_frame* parent, size_t slot, uint64_t* out, std::atomic_flag* finished)
+	{
+		if (n < 2)
+		{
+			fib_complete(parent, slot, n, out, finished);
+			return;
+		}
+		fib_frame* frame = new fib_frame{ parent, slot };
+		pool.enqueue_job([=, &pool]() {fib_job(pool, n - 1, frame, 0, out, finished); });
+		pool.enqueue_job([=, &pool]() {fib_job(pool, n - 2, frame, 1, out, finished); });
+	}
+
+	//one job per call
+	constexpr uint64_t fib_jobs(int n)
+	{
+		return n < 2 ? 1 : 1 + fib_jobs(n - 1) + fib_jobs(n - 2);
+	}
+
+	measurement fork_join_fib(const config& cfg)
+	{
+		//every call spawns a job for each half of the recursion
+		spool::thread_pool pool(cfg.threads);
+		const int n = cfg.scale >= 1.0 ? 25 : 18;
+		const uint64_t jobs = fib_jobs(n);
+		uint64_t fib = 0;
+		std::atomic_flag finished;
+		return time(jobs, [&]()
+			{
+				pool.enqueue_job([&]() {fib_job(pool, n, nullptr, 0, &fib, &finished); });
+				while (!finished.test())
+				{
+				}
+			});
+	}
+
+	measurement dag_chain(const config& cfg)
+	{
+		//each job depends on the one before it, so nothing can run in parallel
+		spool::thread_pool pool(cfg.threads);
+		const size_t n = scaled(20'000, cfg);
+		return time(n, [&]()
+			{
+				std::shared_ptr<spool::job> last = pool.enqueue_job([]() {});
+				for (size_t i = 1; i < n; i++)
+				{
+					last = pool.enqueue_job([]() {}, last);
+				}
+				wait_for(last);
+			});
+	}
+
+	measurement dag_fan_in(const config& cfg)
+	{
+		//rounds of many independent jobs joined by a single dependant
+		spool::thread_pool pool(cfg.threads);
+		constexpr size_t width = 1000;
+		const size_t rounds = scaled(100, cfg);
+		std::vector<std::shared_ptr<spool::job>> fan;
+		fan.reserve(width);
+		return time(rounds * (width + 1), [&]()
+			{
+				for (size_t r = 0; r < rounds; r++)
+				{
+					fan.clear();
+					for (size_t i = 0; i < width; i++)
+					{
+						fan.push_back(pool.enqueue_job([]() {}));
+					}
+					wait_for(pool.enqueue_job([]() {}, fan));
+				}
+			});
+	}
+
+	measurement for_each_ints(const config& cfg)
+	{
+		spool::thread_pool pool(cfg.threads);
+		std::vector<int> ints(scaled(100'000'000, cfg), 1);
+		return time(ints.size(), [&]()
+			{
+				wait_for(pool.enqueue_job([]() {}, pool.for_each(ints, [](int& i) {i = i * 3 + 1; })));
+			});
+	}
+
+	std::vector<uint32_t> random_ints(size_t n)
+	{
+		std::vector<uint32_t> ints(n);
+		uint32_t state = 12345;
+		for (auto& i : ints)
+		{
+			//xorshift, we only need it cheap and repeatable
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			i = state;
+		}
+		return ints;
+	}
+
+	template<bool stable>
+	measurement parallel_sort_ints(const config& cfg)
+	{
+		spool::thread_pool pool(cfg.threads);
+		std::vector<uint32_t> ints = random_ints(scaled(10'000'000, cfg));
+		return time(ints.size(), [&]()
+			{
+				wait_for(stable ? pool.parallel_stable_sort(ints) : pool.parallel_sort(ints));
+			});
+	}
+
+	measurement shared_resource_contention(const config& cfg)
+	{
+		//nine readers for every writer, all fighting over one resource
+		spool::thread_pool pool(cfg.threads);
+		spool::shared_resource<uint64_t> resource(0);
+		const size_t n = scaled(100'000, cfg);
+		std::atomic_size_t remaining = n;
+		return time(n, [&]()
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					if (i % 10 == 0)
+					{
+						pool.enqueue_shared_resource_job([&](uint64_t& v) {v++; remaining.fetch_sub(1, std::memory_order_relaxed); }, resource.create_write_provider());
+					}
+					else
+					{
+						pool.enqueue_shared_resource_job([&](const uint64_t&) {remaining.fetch_sub(1, std::memory_order_relaxed); }, resource.create_read_provider());
+					}
+				}
+				while (remaining.load(std::memory_order_relaxed) != 0)
+				{
+				}
+			});
+	}
+
+	measurement input_data_handoff(const config& cfg)
+	{
+		//latency from submit to the waiting job starting, one handoff at a time
+		spool::thread_pool pool(cfg.threads);
+		const size_t n = scaled(2'000, cfg);
+		std::chrono::nanoseconds total{ 0 };
+		for (size_t i = 0; i < n; i++)
+		{
+			std::atomic<bench_clock::time_point> started;
+			auto handoff = pool.enqueue_data_job<int>([&](const int&) {started.store(bench_clock::now()); });
+			//let the job get picked up and start polling for its data
+			std::this_thread::yield();
+			const auto submitted = bench_clock::now();
+			handoff.data->submit(1);
+			wait_for(handoff.job);
+			total += started.load() - submitted;
+		}
+		return { n, total };
+	}
+
+#pragma endregion spool_cases
+
+#pragma region wsq_cases
+
+	//the queue on its own, comparing shared_ptr slots against the plain pointer slots the pool uses
+	struct payload
+	{
+		uint64_t value = 0;
+	};
+
+	template<typename T>
+	T make_item(const std::shared_ptr<payload>& owner)
+	{
+		if constexpr (std::same_as<T, payload*>)
+		{
+			return owner.get();
+		}
+		else
+		{
+			return owner;
+		}
+	}
+
+	template<typename T>
+	measurement wsq_push_pop(const config& cfg)
+	{
+		//owner only, in batches that stay within the starting capacity
+		const size_t n = scaled(10'000'000, cfg);
+		constexpr size_t batch = 256;
+		spool::detail::WorkStealingQueue<T> queue(1024);
+		const auto owner = std::make_shared<payload>();
+		const T item = make_item<T>(owner);
+		uint64_t popped = 0;
+		const auto m = time(n, [&]()
+			{
+				for (size_t done = 0; done < n; done += batch)
+				{
+					for (size_t i = 0; i < batch; i++)
+					{
+						queue.push(item);
+					}
+					while (const auto got = queue.pop())
+					{
+						popped += got.value() != nullptr;
+					}
+				}
+			});
+		return { popped, m.elapsed };
+	}
+
+	template<typename T>
+	measurement wsq_steal(const config& cfg)
+	{
+		//the owner pushes while every other thread steals, each item is taken exactly once
+		const size_t n = scaled(2'000'000, cfg);
+		spool::detail::WorkStealingQueue<T> queue(1024);
+		const auto owner = std::make_shared<payload>();
+		const T item = make_item<T>(owner);
+		std::atomic_size_t taken = 0;
+		std::atomic_bool go = false;
+		std::vector<std::thread> thieves;
+		for (unsigned int i = 1; i < std::max(2u, cfg.threads); i++)
+		{
+			thieves.emplace_back([&]()
+				{
+					while (!go.load(std::memory_order_acquire))
+					{
+					}
+					while (taken.load(std::memory_order_relaxed) < n)
+					{
+						if (queue.steal().has_value())
+						{
+							taken.fetch_add(1, std::memory_order_relaxed);
+						}
+					}
+				});
+		}
+		auto m = time(n, [&]()
+			{
+				go.store(true, std::memory_order_release);
+				for (size_t i = 0; i < n; i++)
+				{
+					queue.push(item);
+				}
+				while (taken.load(std::memory_order_relaxed) < n)
+				{
+					if (queue.pop().has_value())
+					{
+						taken.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			});
+		for (auto& t : thieves)
+		{
+			t.join();
+		}
+		return m;
+	}
+
+#pragma endregion wsq_cases
+
+#pragma region baselines
+
+	measurement std_thread_for_each_ints(const config& cfg)
+	{
+		std::vector<int> ints(scaled(100'000'000, cfg), 1);
+		return time(ints.size(), [&]()
+			{
+				std::vector<std::thread> threads;
+				const size_t chunk = (ints.size() + cfg.threads - 1) / cfg.threads;
+				for (size_t start = 0; start < ints.size(); start += chunk)
+				{
+					threads.emplace_back([&, start]()
+						{
+							std::for_each(ints.begin() + start, ints.begin() + std::min(start + chunk, ints.size()), [](int& i) {i = i * 3 + 1; });
+						});
+				}
+				for (auto& t : threads)
+				{
+					t.join();
+				}
+			});
+	}
+
+	measurement std_async_for_each_ints(const config& cfg)
+	{
+		std::vector<int> ints(scaled(100'000'000, cfg), 1);
+		return time(ints.size(), [&]()
+			{
+				std::vector<std::future<void>> futures;
+				const size_t chunk = (ints.size() + cfg.threads - 1) / cfg.threads;
+				for (size_t start = 0; start < ints.size(); start += chunk)
+				{
+					futures.push_back(std::async(std::launch::async, [&, start]()
+						{
+							std::for_each(ints.begin() + start, ints.begin() + std::min(start + chunk, ints.size()), [](int& i) {i = i * 3 + 1; });
+						}));
+				}
+				for (auto& f : futures)
+				{
+					f.get();
+				}
+			});
+	}
+
+	measurement std_sort_ints(const config& cfg)
+	{
+		std::vector<uint32_t> ints = random_ints(scaled(10'000'000, cfg));
+		return time(ints.size(), [&]() { std::ranges::sort(ints); });
+	}
+
+	measurement std_thread_empty_tasks(const config& cfg)
+	{
+		//one thread per task, at most `threads` alive at once
+		const size_t n = scaled(10'000, cfg);
+		std::atomic_size_t remaining = n;
+		return time(n, [&]()
+			{
+				std::vector<std::thread> threads;
+				for (size_t i = 0; i < n; i += cfg.threads)
+				{
+					threads.clear();
+					for (size_t j = i; j < std::min<size_t>(i + cfg.threads, n); j++)
+					{
+						threads.emplace_back([&]() {remaining.fetch_sub(1, std::memory_order_relaxed); });
+					}
+					for (auto& t : threads)
+					{
+						t.join();
+					}
+				}
+			});
+	}
+
+	measurement std_async_empty_tasks(const config& cfg)
+	{
+		const size_t n = scaled(10'000, cfg);
+		std::atomic_size_t remaining = n;
+		return time(n, [&]()
+			{
+				std::vector<std::future<void>> futures;
+				futures.reserve(n);
+				for (size_t i = 0; i < n; i++)
+				{
+					futures.push_back(std::async(std::launch::async, [&]() {remaining.fetch_sub(1, std::memory_order_relaxed); }));
+				}
+				for (auto& f : futures)
+				{
+					f.get();
+				}
+			});
+	}
+
+#pragma endregion baselines
+
+	std::vector<bench_case> all_cases()
+	{
+		return {
+			{"empty_jobs_local", empty_jobs_local},
+			{"empty_jobs_external", empty_jobs_external},
+			{"fork_join_fib", fork_join_fib},
+			{"dag_chain", dag_chain},
+			{"dag_fan_in", dag_fan_in},
+			{"for_each_ints", for_each_ints},
+			{"parallel_sort_ints", parallel_sort_ints<false>},
+			{"parallel_stable_sort_ints", parallel_sort_ints<true>},
+			{"shared_resource_contention", shared_resource_contention},
+			{"input_data_handoff", input_data_handoff},
+			{"wsq/push_pop_raw", wsq_push_pop<payload*>},
+			{"wsq/push_pop_shared_ptr", wsq_push_pop<std::shared_ptr<payload>>},
+			{"wsq/steal_raw", wsq_steal<payload*>},
+			{"wsq/steal_shared_ptr", wsq_steal<std::shared_ptr<payload>>},
+			{"baseline/std_thread_for_each_ints", std_thread_for_each_ints},
+			{"baseline/std_async_for_each_ints", std_async_for_each_ints},
+			{"baseline/std_sort_ints", std_sort_ints},
+			{"baseline/std_thread_empty_tasks", std_thread_empty_tasks},
+			{"baseline/std_async_empty_tasks", std_async_empty_tasks},
+		};
+	}
+
+	void write_json(std::ostream& out, const std::vector<result>& results, double scale, size_t repetitions)
+	{
+		out << "{\n  \"context\": {\"hardware_concurrency\": " << std::thread::hardware_concurrency()
+			<< ", \"scale\": " << scale << ", \"repetitions\": " << repetitions << "},\n  \"benchmarks\": [";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			std::vector<double> sorted = r.ns_per_op;
+			std::ranges::sort(sorted);
+			const double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+			out << (i == 0 ? "\n" : ",\n")
+				<< "    {\"name\": \"" << r.name << "\", \"threads\": " << r.threads << ", \"ops\": " << r.ops
+				<< ", \"ns_per_op_min\": " << sorted.front() << ", \"ns_per_op_median\": " << sorted[sorted.size() / 2]
+				<< ", \"ns_per_op_mean\": " << mean << "}";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+	//empty if any count isn't a whole number of at least one
+	std::vector<unsigned int> parse_threads(const std::string& list)
+	{
+		std::vector<unsigned int> threads;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			unsigned int count = 0;
+			const char* const last = item.data() + item.size();
+			const auto [end, error] = std::from_chars(item.data(), last, count);
+			if (error != std::errc() || end != last || count == 0)
+			{
+				return {};
+			}
+			threads.push_back(count);
+		}
+		return threads;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<unsigned int> thread_counts{ std::max(1u, std::thread::hardware_concurrency()) };
+	std::string filter;
+	double scale = 1.0;
+	size_t repetitions = 5;
+	const char* const usage = "usage: spool_bench [--threads 1,2,4] [--filter substring] [--scale 1.0] [--repetitions 5]\n";
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc)
+		{
+			thread_counts = parse_threads(argv[++i]);
+			if (thread_counts.empty())
+			{
+				std::cerr << usage;
+				return 1;
+			}
+		}
+		else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--scale" && i + 1 < argc) scale = std::stod(argv[++i]);
+		else if (arg == "--repetitions" && i + 1 < argc) repetitions = std::max<size_t>(1, std::stoul(argv[++i]));
+		else
+		{
+			std::cerr << usage;
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	std::vector<result> results;
+	for (const auto& bench : all_cases())
+	{
+		if (!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+		for (unsigned int threads : thread_counts)
+		{
+			result r{ bench.name, threads, 0, {} };
+			for (size_t rep = 0; rep < repetitions; rep++)
+			{
+				const measurement m = bench.run({ threads, scale });
+				r.ops = m.ops;
+				r.ns_per_op.push_back(static_cast<double>(m.elapsed.count()) / m.ops);
+			}
+			std::cerr << bench.name << " threads=" << threads << " " << *std::ranges::min_element(r.ns_per_op) << " ns/op\n";
+			results.push_back(std::move(r));
+		}
+	}
+	write_json(std::cout, results, scale, repetitions);
+	return 0;
+}
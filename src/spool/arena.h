@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+
+#include "MPMCQueue.h"
+#include "job.h"
+
+namespace spool
+{
+	namespace detail
+	{
+		constexpr size_t max_arenas = 64;
+		constexpr size_t max_arena_jobs = 1024;
+	}
+
+	struct arena_options final
+	{
+		//a label for the arena, must outlive the pool
+		const char* name = nullptr;
+		//the most of the arena's queued jobs that may be running at once, 0 for no limit
+		unsigned int max_concurrency = 0;
+		//how many jobs a worker takes from this arena before moving on to the next, relative to other arenas
+		unsigned int weight = 1;
+	};
+
+	//a share of a pool's workers with its own queue, so that independent subsystems can use one pool without one starving the others
+	//arenas are created by and live as long as their pool, jobs are put in one through job_options::arena
+	class arena final
+	{
+		friend thread_pool;
+	public:
+		arena(const arena& other) = delete;
+		arena(arena&& other) = delete;
+
+		//cancels every job put in the arena so far that hasn't started yet, jobs enqueued afterwards run as normal
+		//the cancelled jobs are skipped as workers reach them, so that their dependants are cancelled in turn
+		void cancel()
+		{
+			generation.fetch_add(1, std::memory_order_acq_rel);
+		}
+
+		//waits for every job in the arena to finish, must not be called from one of the arena's own jobs
+		void wait() const
+		{
+			while (pending.load(std::memory_order_acquire) != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		bool is_idle() const
+		{
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+
+		//jobs enqueued into the arena that haven't finished yet
+		size_t pending_jobs() const
+		{
+			return pending.load(std::memory_order_relaxed);
+		}
+
+		//jobs taken from the arena's queue that are currently being run
+		unsigned int running_jobs() const
+		{
+			return running.load(std::memory_order_relaxed);
+		}
+
+		const char* get_name() const
+		{
+			return options.name;
+		}
+
+	private:
+		explicit arena(const arena_options& options)
+			:options(options), jobs(detail::max_arena_jobs)
+		{
+			if (this->options.weight == 0) this->options.weight = 1;
+		}
+
+		//claims one of the arena's concurrency slots
+		bool try_acquire()
+		{
+			const unsigned int limit = options.max_concurrency == 0 ? UINT_MAX : options.max_concurrency;
+			unsigned int current = running.load(std::memory_order_relaxed);
+			while (current < limit)
+			{
+				if (running.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void release()
+		{
+			running.fetch_sub(1, std::memory_order_release);
+		}
+
+		void finish()
+		{
+			pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		//true if the arena has been cancelled since the job was put in it
+		bool cancelled_since(uint64_t job_generation) const
+		{
+			return generation.load(std::memory_order_acquire) != job_generation;
+		}
+
+		arena_options options;
+		rigtorp::mpmc::Queue<std::shared_ptr<job>> jobs;
+		std::atomic_size_t pending = 0;
+		std::atomic_uint running = 0;
+		std::atomic_uint64_t generation = 0;
+	};
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define SPOOL_HAS_FILE_IO 1
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && !defined(SPOOL_DISABLE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define SPOOL_HAS_IO_URING 1
+#endif
+
+#include "input_data.h"
+
+namespace spool
+{
+	//the outcome of an asynchronous read
+	struct file_read final
+	{
+		//the part of the buffer that was filled, shorter than asked for at the end of the file
+		std::span<std::byte> data;
+		//the errno the read failed with, 0 on success
+		int error = 0;
+	};
+
+	namespace detail
+	{
+#ifdef SPOOL_HAS_FILE_IO
+		//a plain blocking read, used wherever there's no ring to hand the read to
+		inline file_read read_at(int fd, uint64_t offset, std::span<std::byte> buffer)
+		{
+			const ssize_t result = pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(offset));
+			if (result < 0)
+			{
+				return { {}, errno };
+			}
+			return { buffer.first(static_cast<size_t>(result)), 0 };
+		}
+#endif
+
+#ifdef SPOOL_HAS_IO_URING
+		constexpr unsigned int io_ring_entries = 256;
+
+		//a read handed to the kernel, owned by the ring until its completion is reaped
+		struct pending_read final
+		{
+			std::shared_ptr<input_data<file_read>> destination;
+			std::span<std::byte> buffer;
+			iovec vector;
+		};
+
+		//a bare io_uring driven through the raw syscalls, so there's no dependency on liburing
+		//submissions are serialised by a lock, completions are reaped by whichever worker gets to them first
+		class io_ring final
+		{
+		public:
+			explicit io_ring(unsigned int entries)
+			{
+				io_uring_params params{};
+				const long fd = syscall(__NR_io_uring_setup, entries, &params);
+				if (fd < 0)
+				{
+					//not supported, or forbidden by a seccomp filter, callers fall back to blocking reads
+					return;
+				}
+				ring_fd = static_cast<int>(fd);
+				sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+				if (single_mmap)
+				{
+					sq_size = cq_size = std::max(sq_size, cq_size);
+				}
+				sq_ring = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+				cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+				sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+				void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+				if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_map == MAP_FAILED)
+				{
+					if (sqe_map != MAP_FAILED) munmap(sqe_map, sqes_size);
+					release();
+					return;
+				}
+				sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+				char* sq = static_cast<char*>(sq_ring);
+				sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				char* cq = static_cast<char*>(cq_ring);
+				cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+				//never have more in flight than there's room to complete into, so the completion queue can't overflow
+				capacity = std::min(params.sq_entries, params.cq_entries);
+			}
+
+			~io_ring()
+			{
+				if (ring_fd < 0)
+				{
+					return;
+				}
+				//the kernel may still be writing into buffers, see every read through before letting go of them
+				while (in_flight.load(std::memory_order_acquire) != 0)
+				{
+					syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+					reap();
+				}
+				release();
+			}
+
+			io_ring(const io_ring& other) = delete;
+			io_ring(io_ring&& other) = delete;
+
+			bool available() const
+			{
+				return sqes != nullptr;
+			}
+
+			//hands a read to the kernel, returns false if the ring is full or the submission was refused
+			bool submit_read(int fd, uint64_t offset, std::unique_ptr<pending_read>& read)
+			{
+				std::scoped_lock lock(submit_lock);
+				if (in_flight.load(std::memory_order_relaxed) >= capacity)
+				{
+					return false;
+				}
+				read->vector = { read->buffer.data(), read->buffer.size() };
+				const unsigned tail = *sq_tail;
+				const unsigned index = tail & sq_mask;
+				io_uring_sqe& sqe = sqes[index];
+				std::memset(&sqe, 0, sizeof(sqe));
+				//readv rather than read, it's been around since the first kernels with io_uring
+				sqe.opcode = IORING_OP_READV;
+				sqe.fd = fd;
+				sqe.off = offset;
+				sqe.addr = reinterpret_cast<uint64_t>(&read->vector);
+				sqe.len = 1;
+				sqe.user_data = reinterpret_cast<uint64_t>(read.get());
+				sq_array[index] = index;
+				std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+				//counted before entering, the completion could be reaped before the syscall even returns
+				in_flight.fetch_add(1, std::memory_order_acq_rel);
+				if (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) != 1)
+				{
+					//take the entry back, the kernel didn't consume it
+					std::atomic_ref<unsigned>(*sq_tail).store(tail, std::memory_order_release);
+					in_flight.fetch_sub(1, std::memory_order_acq_rel);
+					return false;
+				}
+				read.release();
+				return true;
+			}
+
+			//submits the results of any completed reads, returns how many there were
+			//only one thread reaps at a time, anyone else finding the ring busy just moves on
+			size_t reap()
+			{
+				std::unique_lock lock(reap_lock, std::try_to_lock);
+				if (!lock.owns_lock())
+				{
+					return 0;
+				}
+				unsigned head = *cq_head;
+				const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+				size_t reaped = 0;
+				for (; head != tail; head++, reaped++)
+				{
+					const io_uring_cqe& cqe = cqes[head & cq_mask];
+					std::unique_ptr<pending_read> read(reinterpret_cast<pending_read*>(cqe.user_data));
+					const int result = cqe.res;
+					if (result < 0)
+					{
+						read->destination->submit(file_read{ {}, -result });
+					}
+					else
+					{
+						read->destination->submit(file_read{ read->buffer.first(static_cast<size_t>(result)), 0 });
+					}
+				}
+				std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+				in_flight.fetch_sub(reaped, std::memory_order_acq_rel);
+				return reaped;
+			}
+
+			size_t reads_in_flight() const
+			{
+				return in_flight.load(std::memory_order_relaxed);
+			}
+
+		private:
+			void release()
+			{
+				if (sqes != nullptr) munmap(sqes, sqes_size);
+				if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_size);
+				if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_size);
+				close(ring_fd);
+				sqes = nullptr;
+				ring_fd = -1;
+			}
+
+			int ring_fd = -1;
+			void* sq_ring = MAP_FAILED;
+			void* cq_ring = MAP_FAILED;
+			size_t sq_size = 0;
+			size_t cq_size = 0;
+			size_t sqes_size = 0;
+			io_uring_sqe* sqes = nullptr;
+			unsigned* sq_tail = nullptr;
+			unsigned* sq_array = nullptr;
+			unsigned sq_mask = 0;
+			unsigned* cq_head = nullptr;
+			unsigned* cq_tail = nullptr;
+			unsigned cq_mask = 0;
+			io_uring_cqe* cqes = nullptr;
+			size_t capacity = 0;
+			std::atomic_size_t in_flight = 0;
+			std::mutex submit_lock;
+			std::mutex reap_lock;
+		};
+#endif
+	}
+}
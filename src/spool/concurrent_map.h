@@ -0,0 +1,240 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <ranges>
+#include <utility>
+#include <concepts>
+#include <cassert>
+#include <cstddef>
+
+#include "concepts.h"
+#include "stats.h"
+#include "shared_resource.h"
+#include "job_utils.h"
+#include "thread_pool.h"
+
+namespace spool
+{
+	namespace detail
+	{
+		constexpr size_t default_map_shards = 64;
+	}
+
+	//a hash map split into shards, each its own shared_resource, so jobs touching different keys rarely wait on each other
+	//access goes through providers like any other shared resource, either to a whole shard or to the value for a single key
+	template<typename K, typename V, typename Hash = std::hash<K>>
+	class concurrent_map final
+	{
+	public:
+		using map_type = std::unordered_map<K, V, Hash>;
+		using shard_type = shared_resource<map_type>;
+
+		explicit concurrent_map(size_t shard_count = detail::default_map_shards)
+			:count(shard_count), shards(new padded_shard[shard_count])
+		{
+			assert(shard_count > 0);
+		}
+
+		concurrent_map(const concurrent_map& other) = delete;
+		concurrent_map(concurrent_map&& other) = delete;
+
+		size_t shard_count() const
+		{
+			return count;
+		}
+
+		size_t shard_of(const K& key) const
+		{
+			return Hash{}(key) % count;
+		}
+
+		shard_type& shard(size_t index)
+		{
+			return shards[index].resource;
+		}
+
+		//the number of entries, only meaningful while nothing is writing
+		size_t size()
+		{
+			size_t total = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				total += shards[i].resource.get().size();
+			}
+			return total;
+		}
+
+#pragma region providers
+
+		//the whole of one shard
+		auto create_shard_read_provider(size_t index)
+		{
+			return shard(index).create_read_provider();
+		}
+
+		auto create_shard_write_provider(size_t index)
+		{
+			return shard(index).create_write_provider();
+		}
+
+		//the value for one key, a key that isn't there reads as a default constructed value
+		auto create_read_provider(const K& key)
+			requires std::default_initializable<V>
+		{
+			return key_provider<false>(this, key);
+		}
+
+		//the value for one key, default constructed first if the key isn't there
+		auto create_write_provider(const K& key)
+			requires std::default_initializable<V>
+		{
+			return key_provider<true>(this, key);
+		}
+
+#pragma endregion providers
+
+#pragma region parallel
+
+		//inserts every key value pair in items, one job per shard, so no two jobs ever want the same shard
+		//items are sorted into shards by chunk jobs first, the returned jobs are the inserting ones, items must outlive them
+		template<std::ranges::forward_range R>
+			requires std::convertible_to<range_underlying<R>, std::pair<K, V>>
+		std::vector<std::shared_ptr<job>> build(thread_pool& pool, R& items)
+		{
+			auto chunks = detail::split_range(items, pool.worker_count());
+			//buckets[chunk][shard], each chunk job only ever touches its own row
+			auto buckets = std::make_shared<std::vector<std::vector<std::vector<std::pair<K, V>>>>>(chunks.size(), std::vector<std::vector<std::pair<K, V>>>(count));
+			std::vector<std::shared_ptr<job>> sorting;
+			for (size_t c = 0; c < chunks.size(); c++)
+			{
+				sorting.push_back(pool.enqueue_job([this, buckets, c, chunk = chunks[c]]()
+					{
+						auto& row = (*buckets)[c];
+						for (const auto& item : chunk)
+						{
+							const std::pair<K, V> entry = item;
+							row[shard_of(entry.first)].push_back(entry);
+						}
+					}));
+			}
+			std::vector<std::shared_ptr<job>> inserting;
+			for (size_t s = 0; s < count; s++)
+			{
+				inserting.push_back(pool.enqueue_shared_resource_job([buckets, s](map_type& map)
+					{
+						for (auto& row : *buckets)
+						{
+							for (auto& entry : row[s])
+							{
+								map.insert_or_assign(std::move(entry.first), std::move(entry.second));
+							}
+						}
+					}, sorting, create_shard_write_provider(s)));
+			}
+			return inserting;
+		}
+
+		//calls func with every key and value, one job per shard holding that shard for reading
+		template<typename F>
+			requires std::invocable<const F&, const K&, const V&> && std::copy_constructible<F>
+		std::vector<std::shared_ptr<job>> for_each(thread_pool& pool, const F& func)
+		{
+			std::vector<std::shared_ptr<job>> jobs;
+			for (size_t s = 0; s < count; s++)
+			{
+				jobs.push_back(pool.enqueue_shared_resource_job([func](const map_type& map)
+					{
+						for (const auto& [key, value] : map)
+						{
+							func(key, value);
+						}
+					}, create_shard_read_provider(s)));
+			}
+			return jobs;
+		}
+
+#pragma endregion parallel
+
+	private:
+		struct alignas(detail::cache_line_size) padded_shard
+		{
+			shard_type resource;
+		};
+
+		template<bool write>
+		class key_handle final
+		{
+		public:
+			//the key belongs to the provider, which outlives every handle it makes
+			key_handle(concurrent_map& owner, const K& key)
+				:inner(acquire(owner.shard(owner.shard_of(key)))), key(key)
+			{}
+
+			key_handle(const key_handle&) = delete;
+
+			bool has() const
+			{
+				return inner.has();
+			}
+
+			//only called once every handle the job needs is held, so a job that's retried or cancelled never inserts anything
+			std::conditional_t<write, V, const V>& get() const
+			{
+				if constexpr (write)
+				{
+					return inner.get().try_emplace(key).first->second;
+				}
+				else
+				{
+					const auto found = inner.get().find(key);
+					return found == inner.get().end() ? missing() : found->second;
+				}
+			}
+
+		private:
+			static auto acquire(shard_type& shard)
+			{
+				if constexpr (write)
+				{
+					return shard.create_write_handle();
+				}
+				else
+				{
+					return shard.create_read_handle();
+				}
+			}
+
+			static const V& missing()
+			{
+				static const V empty{};
+				return empty;
+			}
+
+			decltype(acquire(std::declval<shard_type&>())) inner;
+			const K& key;
+		};
+
+		template<bool write>
+		class key_provider final
+		{
+		public:
+			key_provider(concurrent_map* owner, const K& key)
+				:owner(owner), key(key)
+			{}
+
+			key_handle<write> get() const
+			{
+				return key_handle<write>(*owner, key);
+			}
+
+		private:
+			concurrent_map* owner;
+			K key;
+		};
+
+		const size_t count;
+		std::unique_ptr<padded_shard[]> shards;
+	};
+}
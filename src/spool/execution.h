@@ -0,0 +1,224 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <vector>
+#include <concepts>
+#include <cstddef>
+
+#include "job.h"
+#include "thread_pool.h"
+
+namespace spool
+{
+	namespace execution
+	{
+		//runs the standard algorithm overloads below on a pool's workers, so they share the pool's cores with everything else it's doing
+		class pool_policy final
+		{
+		public:
+			explicit pool_policy(thread_pool& pool)
+				:target(&pool)
+			{}
+
+			thread_pool& pool() const
+			{
+				return *target;
+			}
+
+		private:
+			thread_pool* target;
+		};
+
+		//spool::transform(spool::execution::par(pool), in.begin(), in.end(), out.begin(), op);
+		inline pool_policy par(thread_pool& pool)
+		{
+			return pool_policy(pool);
+		}
+	}
+
+	namespace detail
+	{
+		//called from one of the pool's own workers the calling job would sit blocking a worker the chunks need, so just do it in place
+		inline bool run_serially(const execution::pool_policy& policy, size_t count)
+		{
+			return count <= 1 || policy.pool().current_worker_index() != SIZE_MAX;
+		}
+
+		//the jobs reference the caller's stack, so every one has to be done before a failure can be passed on
+		inline void wait_all(const std::vector<std::shared_ptr<job>>& jobs)
+		{
+			std::exception_ptr error;
+			for (auto& j : jobs)
+			{
+				try
+				{
+					j->wait();
+				}
+				catch (...)
+				{
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		//runs work(begin, end) over [0, count) on the pool and waits for all of it, rethrowing the first failure
+		template<typename F>
+		void run_chunks(const execution::pool_policy& policy, size_t count, const F& work)
+		{
+			if (run_serially(policy, count))
+			{
+				work(size_t(0), count);
+				return;
+			}
+			wait_all(policy.pool().for_each_chunk(count, [&work](size_t begin, size_t end) {work(begin, end); }));
+		}
+	}
+
+#pragma region algorithms
+	//these all block until done, and run in place rather than on the pool when called from one of the pool's workers
+
+	template<std::random_access_iterator It, typename F>
+		requires std::invocable<F&, std::iter_reference_t<It>>
+	void for_each(const execution::pool_policy& policy, It first, It last, F func)
+	{
+		detail::run_chunks(policy, static_cast<size_t>(last - first), [&](size_t begin, size_t end)
+			{
+				std::for_each(first + begin, first + end, func);
+			});
+	}
+
+	template<std::random_access_iterator It, std::random_access_iterator Out, typename F>
+	Out transform(const execution::pool_policy& policy, It first, It last, Out destination, F op)
+	{
+		const size_t count = static_cast<size_t>(last - first);
+		detail::run_chunks(policy, count, [&](size_t begin, size_t end)
+			{
+				std::transform(first + begin, first + end, destination + begin, op);
+			});
+		return destination + count;
+	}
+
+	template<std::random_access_iterator It1, std::random_access_iterator It2, std::random_access_iterator Out, typename F>
+	Out transform(const execution::pool_policy& policy, It1 first1, It1 last1, It2 first2, Out destination, F op)
+	{
+		const size_t count = static_cast<size_t>(last1 - first1);
+		detail::run_chunks(policy, count, [&](size_t begin, size_t end)
+			{
+				std::transform(first1 + begin, first1 + end, first2 + begin, destination + begin, op);
+			});
+		return destination + count;
+	}
+
+	//keeps the order of the input, chunks count their matches first, then copy into place once they know where theirs start
+	template<std::random_access_iterator It, std::random_access_iterator Out, typename P>
+	Out copy_if(const execution::pool_policy& policy, It first, It last, Out destination, P pred)
+	{
+		const size_t count = static_cast<size_t>(last - first);
+		if (detail::run_serially(policy, count))
+		{
+			return std::copy_if(first, last, destination, pred);
+		}
+		//one flag per element, so the predicate is only ever called once for each
+		std::unique_ptr<bool[]> matches(new bool[count]);
+		const auto chunks = detail::chunk_bounds(count, policy.pool().worker_count());
+		std::vector<size_t> offsets(chunks.size() + 1, 0);
+		std::vector<std::shared_ptr<job>> jobs;
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			jobs.push_back(policy.pool().enqueue_job([&, c]()
+				{
+					size_t found = 0;
+					for (size_t i = chunks[c].first; i < chunks[c].first + chunks[c].second; i++)
+					{
+						matches[i] = static_cast<bool>(pred(first[i]));
+						found += matches[i];
+					}
+					offsets[c + 1] = found;
+				}));
+		}
+		detail::wait_all(jobs);
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			offsets[c + 1] += offsets[c];
+		}
+		jobs.clear();
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			jobs.push_back(policy.pool().enqueue_job([&, c]()
+				{
+					Out out = destination + offsets[c];
+					for (size_t i = chunks[c].first; i < chunks[c].first + chunks[c].second; i++)
+					{
+						if (matches[i])
+						{
+							*out++ = first[i];
+						}
+					}
+				}));
+		}
+		detail::wait_all(jobs);
+		return destination + offsets.back();
+	}
+
+	//the first match, as std::find_if would find it, even if a later chunk finds one of its own first, see thread_pool::parallel_find_if
+	template<std::random_access_iterator It, typename P>
+	It find_if(const execution::pool_policy& policy, It first, It last, P pred)
+	{
+		if (detail::run_serially(policy, static_cast<size_t>(last - first)))
+		{
+			return std::find_if(first, last, pred);
+		}
+		std::ranges::subrange range(first, last);
+		const auto search = policy.pool().parallel_find_if(range, pred);
+		search.job->wait();
+		return first + search.data->create_read_handle().get();
+	}
+
+	template<std::random_access_iterator It, typename P>
+	bool any_of(const execution::pool_policy& policy, It first, It last, P pred)
+	{
+		if (detail::run_serially(policy, static_cast<size_t>(last - first)))
+		{
+			return std::any_of(first, last, pred);
+		}
+		std::ranges::subrange range(first, last);
+		const auto search = policy.pool().parallel_any_of(range, pred);
+		search.job->wait();
+		return search.data->create_read_handle().get();
+	}
+
+	template<std::random_access_iterator It, typename P>
+	bool none_of(const execution::pool_policy& policy, It first, It last, P pred)
+	{
+		return !spool::any_of(policy, first, last, pred);
+	}
+
+	template<std::random_access_iterator It, typename P>
+	bool all_of(const execution::pool_policy& policy, It first, It last, P pred)
+	{
+		return spool::find_if(policy, first, last, [&pred](const auto& value) {return !pred(value); }) == last;
+	}
+
+	template<std::random_access_iterator It, typename P>
+	std::iter_difference_t<It> count_if(const execution::pool_policy& policy, It first, It last, P pred)
+	{
+		std::atomic<std::iter_difference_t<It>> total = 0;
+		detail::run_chunks(policy, static_cast<size_t>(last - first), [&](size_t begin, size_t end)
+			{
+				total.fetch_add(std::count_if(first + begin, first + end, pred), std::memory_order_relaxed);
+			});
+		return total.load(std::memory_order_relaxed);
+	}
+#pragma endregion algorithms
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "stats.h"
+
+namespace spool
+{
+	namespace detail
+	{
+#if !defined(SPOOL_DISABLE_STATS) && !defined(SPOOL_DISABLE_LATENCY)
+		constexpr bool latency_enabled = true;
+#else
+		constexpr bool latency_enabled = false;
+#endif
+
+		//each power of two is split into this many linear sub-buckets, giving roughly 12% precision at any scale
+		constexpr size_t histogram_sub_bucket_bits = 3;
+		constexpr size_t histogram_sub_buckets = size_t(1) << histogram_sub_bucket_bits;
+		constexpr size_t histogram_bucket_count = (64 - histogram_sub_bucket_bits + 1) * histogram_sub_buckets;
+
+		constexpr size_t histogram_bucket(uint64_t value)
+		{
+			if (value < histogram_sub_buckets)
+			{
+				return static_cast<size_t>(value);
+			}
+			const size_t exponent = std::bit_width(value) - 1;
+			const size_t sub = static_cast<size_t>(value >> (exponent - histogram_sub_bucket_bits)) & (histogram_sub_buckets - 1);
+			return (exponent - histogram_sub_bucket_bits + 1) * histogram_sub_buckets + sub;
+		}
+
+		//the largest value that lands in a bucket
+		constexpr uint64_t histogram_bucket_upper(size_t bucket)
+		{
+			if (bucket < histogram_sub_buckets)
+			{
+				return bucket;
+			}
+			const size_t shift = bucket / histogram_sub_buckets - 1;
+			const uint64_t sub = bucket % histogram_sub_buckets;
+			return ((histogram_sub_buckets + sub + 1) << shift) - 1;
+		}
+
+		class worker_histogram;
+	}
+
+	//a log-bucketed histogram of durations, cheap to merge and to subtract
+	class latency_histogram final
+	{
+		friend detail::worker_histogram;
+	public:
+		void record(std::chrono::nanoseconds duration)
+		{
+			const uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+			buckets[detail::histogram_bucket(ns)]++;
+			total_count++;
+			total_ns += ns;
+		}
+
+		uint64_t count() const
+		{
+			return total_count;
+		}
+
+		std::chrono::nanoseconds mean() const
+		{
+			return std::chrono::nanoseconds(total_count == 0 ? 0 : total_ns / total_count);
+		}
+
+		//the value below which the given fraction (0 to 1) of recorded durations fall, accurate to the bucket it lands in
+		std::chrono::nanoseconds percentile(double fraction) const
+		{
+			if (total_count == 0)
+			{
+				return std::chrono::nanoseconds(0);
+			}
+			const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * total_count + 0.5));
+			uint64_t seen = 0;
+			for (size_t i = 0; i < buckets.size(); i++)
+			{
+				seen += buckets[i];
+				if (seen >= rank)
+				{
+					return std::chrono::nanoseconds(detail::histogram_bucket_upper(i));
+				}
+			}
+			return std::chrono::nanoseconds(detail::histogram_bucket_upper(buckets.size() - 1));
+		}
+
+		std::chrono::nanoseconds max() const
+		{
+			return percentile(1.0);
+		}
+
+		latency_histogram& operator+=(const latency_histogram& other)
+		{
+			for (size_t i = 0; i < buckets.size(); i++)
+			{
+				buckets[i] += other.buckets[i];
+			}
+			total_count += other.total_count;
+			total_ns += other.total_ns;
+			return *this;
+		}
+
+		latency_histogram operator-(const latency_histogram& earlier) const
+		{
+			latency_histogram delta = *this;
+			for (size_t i = 0; i < buckets.size(); i++)
+			{
+				delta.buckets[i] -= earlier.buckets[i];
+			}
+			delta.total_count -= earlier.total_count;
+			delta.total_ns -= earlier.total_ns;
+			return delta;
+		}
+
+	private:
+		std::array<uint64_t, detail::histogram_bucket_count> buckets{};
+		uint64_t total_count = 0;
+		uint64_t total_ns = 0;
+	};
+
+	struct latency_stats final
+	{
+		//from being enqueued to a worker first trying to run it
+		latency_histogram queue_delay;
+		//from the first attempt to actually starting, time spent waiting on prerequisites or resources
+		latency_histogram blocked;
+		//from starting to completing
+		latency_histogram run_time;
+
+		latency_stats& operator+=(const latency_stats& other)
+		{
+			queue_delay += other.queue_delay;
+			blocked += other.blocked;
+			run_time += other.run_time;
+			return *this;
+		}
+
+		latency_stats operator-(const latency_stats& earlier) const
+		{
+			return { queue_delay - earlier.queue_delay, blocked - earlier.blocked, run_time - earlier.run_time };
+		}
+	};
+
+	struct pool_latency final
+	{
+		std::vector<latency_stats> workers;
+
+		latency_stats total() const
+		{
+			latency_stats sum;
+			for (const auto& w : workers)
+			{
+				sum += w;
+			}
+			return sum;
+		}
+
+		pool_latency operator-(const pool_latency& earlier) const
+		{
+			pool_latency delta = *this;
+			for (size_t i = 0; i < delta.workers.size() && i < earlier.workers.size(); i++)
+			{
+				delta.workers[i] = workers[i] - earlier.workers[i];
+			}
+			return delta;
+		}
+	};
+
+	namespace detail
+	{
+		//a histogram only ever recorded into by its owning worker, readable from anywhere
+		class worker_histogram final
+		{
+		public:
+			void record(std::chrono::nanoseconds duration)
+			{
+				const uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+				buckets[histogram_bucket(ns)].add();
+				total_ns.add(ns);
+			}
+
+			latency_histogram snapshot() const
+			{
+				//the count is rebuilt from the buckets so that a snapshot taken mid-record stays self consistent
+				latency_histogram recorded;
+				for (size_t i = 0; i < buckets.size(); i++)
+				{
+					recorded.buckets[i] = buckets[i].get();
+					recorded.total_count += recorded.buckets[i];
+				}
+				recorded.total_ns = total_ns.get();
+				return recorded;
+			}
+
+		private:
+			std::array<counter, histogram_bucket_count> buckets;
+			counter total_ns;
+		};
+
+		struct alignas(cache_line_size) worker_latency final
+		{
+			worker_histogram queue_delay;
+			worker_histogram blocked;
+			worker_histogram run_time;
+
+			latency_stats snapshot() const
+			{
+				return { queue_delay.snapshot(), blocked.snapshot(), run_time.snapshot() };
+			}
+		};
+
+		//timestamps carried by each job, used to feed the latency histograms
+		struct job_timing final
+		{
+			std::chrono::steady_clock::time_point enqueued;
+			std::chrono::steady_clock::time_point first_attempt;
+			//the latest attempt to run the job, which becomes its start if the attempt succeeds
+			std::chrono::steady_clock::time_point attempt;
+			std::chrono::steady_clock::time_point started;
+		};
+	}
+}
@@ -1,13 +1,18 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <ranges>
 #include <utility>
 #include <memory>
 #include <variant>
+#include <algorithm>
+#include <exception>
+#include <thread>
 
 #include "MPMCQueue.h"
 #include "concepts.h"
+#include "histogram.h"
 
 namespace spool
 {
@@ -17,8 +22,67 @@ namespace spool
         constexpr size_t max_job_prerequisites = 1024;
     }
     class thread_pool;
+    class arena;
 
-    class job final
+    constexpr size_t any_node = SIZE_MAX;
+    constexpr size_t any_worker = SIZE_MAX;
+    constexpr size_t no_group = SIZE_MAX;
+
+    //a shared flag that cancels every job enqueued with it, along with their children and anything depending on them
+    //copies refer to the same flag, a default constructed token can never be cancelled
+    class cancellation_token final
+    {
+    public:
+        static cancellation_token create()
+        {
+            cancellation_token token;
+            token.state = std::make_shared<std::atomic_bool>(false);
+            return token;
+        }
+
+        void cancel() const
+        {
+            if (state != nullptr)
+            {
+                state->store(true, std::memory_order_release);
+            }
+        }
+
+        //cheap enough to poll from inside a long running job
+        bool is_cancelled() const
+        {
+            return state != nullptr && state->load(std::memory_order_acquire);
+        }
+
+        bool can_be_cancelled() const
+        {
+            return state != nullptr;
+        }
+
+    private:
+        std::shared_ptr<std::atomic_bool> state;
+    };
+
+    //optional settings for a job, passed when it's enqueued
+    struct job_options
+    {
+        //a label for the job in traces, must outlive the job
+        const char* name = nullptr;
+        //the numa node whose workers should pick this job up first, other nodes may still steal it
+        size_t node = any_node;
+        //the only worker allowed to run this job, takes priority over group and node
+        size_t worker = any_worker;
+        //a worker group from the pool's options, only workers in the group may run this job, takes priority over node
+        size_t group = no_group;
+        //the arena to run the job in, jobs enqueued from inside an arena's job go into the same arena unless pinned or grouped
+        spool::arena* arena = nullptr;
+        //cancels the job if it hasn't started, jobs enqueued from inside the job inherit it unless given their own
+        cancellation_token cancellation{};
+        //the job is small enough that a worker may run it on the spot rather than queue it, when its own queue is already deep and nobody is idle to steal
+        bool may_inline = false;
+    };
+
+    class job final : public std::enable_shared_from_this<job>
     {
         friend thread_pool;
     public:
@@ -26,10 +90,60 @@ namespace spool
         job(const job& other) = delete;
         job(job&& other) = delete;
 
-        //prevents execution from starting if it hasn't already, but does not cancel or block dependant tasks
+        ~job()
+        {
+            //never completed, most likely abandoned by an exiting pool, let go of anything parked on us
+            job* parked = continuations.exchange(continuations_closed(), std::memory_order_acq_rel);
+            while (parked != nullptr && parked != continuations_closed())
+            {
+                job* next = parked->next_continuation;
+                parked->queued_self.reset();
+                parked = next;
+            }
+        }
+
+        //prevents execution from starting if it hasn't already, dependant jobs are cancelled in turn when they next try to run
         void cancel()
         {
-            done.test_and_set();
+            run_state expected = run_state::pending;
+            if (state.compare_exchange_strong(expected, run_state::cancelled, std::memory_order_acq_rel))
+            {
+                done.test_and_set();
+            }
+        }
+
+        //true if the job was cancelled before it could run, or if it hasn't started yet and its cancellation token has been cancelled
+        //a job already running when its token is cancelled may still finish, so long running jobs should poll the token itself
+        bool is_cancelled() const
+        {
+            const run_state current = state.load(std::memory_order_acquire);
+            return current == run_state::cancelled || (current == run_state::pending && options.cancellation.is_cancelled());
+        }
+
+        //true if the job threw, or if it was skipped because a prerequisite failed
+        bool is_failed() const
+        {
+            return state.load(std::memory_order_acquire) == run_state::failed;
+        }
+
+        //the exception the job or its failed prerequisite threw, null unless is_failed()
+        std::exception_ptr get_exception() const
+        {
+            return is_failed() ? error : nullptr;
+        }
+
+        //blocks until the job is done, rethrowing its exception if it failed
+        //this does not help run other jobs, so must not be called from a job on a pool that could need this thread to finish the job
+        void wait()
+        {
+            while (!done.test())
+            {
+                std::this_thread::yield();
+            }
+            if (is_failed())
+            {
+                std::rethrow_exception(error);
+            }
         }
 
         void add_prerequisite(std::shared_ptr<job> other)
@@ -45,11 +159,16 @@ namespace spool
             return done.test();
         }
 
+        const char* get_name() const
+        {
+            return options.name;
+        }
+
     private:
         template<typename F>
             requires std::convertible_to<F, std::function<void()>> || std::convertible_to<F, std::function<bool()>>
         job(F && work, detail::nil = {})
-            :work(std::forward<F>(work)),
+            :work(make_work(std::forward<F>(work))),
             prerequisites(detail::max_job_prerequisites)
         {}
 
@@ -69,9 +188,28 @@ namespace spool
             add_prerequisite(prerequisite);
         }
 
+        //only an explicit std::function<bool()> is treated as retryable work, anything else has its result discarded
+        template<typename F>
+        static std::variant<std::function<void()>, std::function<bool()>> make_work(F&& work)
+        {
+            if constexpr (std::same_as<std::remove_cvref_t<F>, std::function<bool()>>)
+            {
+                return std::forward<F>(work);
+            }
+            else
+            {
+                return std::function<void()>(std::forward<F>(work));
+            }
+        }
+
         //returns true if the job is finished and should not be re-added to the queue
         bool try_run()
         {
+            if (blocked_on != nullptr)
+            {
+                //left over from the last attempt when we weren't parked on it
+                prerequisites.push(std::move(blocked_on));
+            }
             if (done.test())
             {
                 //skip working if it's already "done"
@@ -80,31 +218,129 @@ namespace spool
             std::shared_ptr<job> p;
             while (prerequisites.try_pop(p))
             {
+                if (p->is_failed())
+                {
+                    //carry the original exception along so whoever waits on the end of the chain sees it
+                    fail(p->error);
+                    return true;
+                }
+                if (p->is_cancelled())
+                {
+                    //whatever we'd be working on was never made, don't run on garbage
+                    cancel();
+                    return true;
+                }
                 if (!p->is_done())
                 {
-                    //we've hit an un-matched prerequisite, put it back and refuse to run
-                    prerequisites.push(p);
+                    //we've hit an un-matched prerequisite, keep it aside for whoever runs us to park us on, and refuse to run
+                    blocked_on = std::move(p);
                     return false;
                 }
             }
 
-            //we aren't watiting on any prerequisites, actually run
-            if (std::holds_alternative<std::function<void()>>(work))
+            //checked after the prerequisites, since they may have finished because of the cancel
+            if (options.cancellation.is_cancelled())
             {
-                std::get<std::function<void()>>(work)();
+                cancel();
+                return true;
             }
-            else if (!(std::get<std::function<bool()>>(work)()))
+
+            //we aren't watiting on any prerequisites, claim the job so a late cancel can't race us
+            run_state expected = run_state::pending;
+            if (!state.compare_exchange_strong(expected, run_state::running, std::memory_order_acq_rel))
             {
-                    return false;
+                return true;
+            }
+            if constexpr (detail::latency_enabled)
+            {
+                //stamped by the worker just before this attempt, unset unless the job is being timed
+                timing.started = timing.attempt;
+            }
+            try
+            {
+                if (std::holds_alternative<std::function<void()>>(work))
+                {
+                    std::get<std::function<void()>>(work)();
+                }
+                else if (!(std::get<std::function<bool()>>(work)()))
+                {
+                        state.store(run_state::pending, std::memory_order_release);
+                        return false;
+                }
+            }
+            catch (...)
+            {
+                //a throwing job mustn't take its worker down with it
+                fail(std::current_exception());
+                return true;
             }
             
 
+            state.store(run_state::finished, std::memory_order_release);
             done.test_and_set();
             return true;
         }
 
+        //parks a dependant until this job is done, returns false if it already is
+        bool add_continuation(const std::shared_ptr<job>& dependant)
+        {
+            dependant->queued_self = dependant;
+            job* head = continuations.load(std::memory_order_acquire);
+            do
+            {
+                if (head == continuations_closed())
+                {
+                    dependant->queued_self.reset();
+                    return false;
+                }
+                dependant->next_continuation = head;
+            } while (!continuations.compare_exchange_weak(head, dependant.get(), std::memory_order_acq_rel, std::memory_order_acquire));
+            return true;
+        }
+
+        static job* continuations_closed()
+        {
+            return reinterpret_cast<job*>(uintptr_t(1));
+        }
+
+        void fail(std::exception_ptr exception)
+        {
+            //claim the job before touching error, a job that's already done may have its error being read
+            run_state current = state.load(std::memory_order_relaxed);
+            while (current == run_state::pending || current == run_state::running)
+            {
+                if (state.compare_exchange_weak(current, run_state::failing, std::memory_order_acq_rel))
+                {
+                    error = std::move(exception);
+                    state.store(run_state::failed, std::memory_order_release);
+                    done.test_and_set();
+                    return;
+                }
+            }
+        }
+
+        //ordered so that everything from finished on is final, failing is held only while fail writes the error
+        enum class run_state : uint8_t
+        {
+            pending, running, failing, finished, failed, cancelled
+        };
+
         std::variant<std::function<void()>, std::function<bool()>> work;
         std::atomic_flag done;
+        std::atomic<run_state> state = run_state::pending;
+        std::exception_ptr error;
+        //set while the job sits in a worker's queue or is parked on a prerequisite, both of which only hold a plain pointer to it
+        std::shared_ptr<job> queued_self;
+        thread_pool* pool = nullptr;
+        //the prerequisite that stopped the last attempt to run, taken out of prerequisites so a parked job doesn't keep it alive
+        std::shared_ptr<job> blocked_on;
+        //dependants parked on this job, linked through next_continuation, closed once a worker has seen the job done
+        std::atomic<job*> continuations = nullptr;
+        job* next_continuation = nullptr;
+        job_options options;
+        detail::job_timing timing;
+        //the arena's cancellation generation when the job was put in it
+        uint64_t arena_generation = 0;
 
         rigtorp::mpmc::Queue<std::shared_ptr<job>> prerequisites;
     };
@@ -3,6 +3,11 @@
 #include <functional>
 #include <ranges>
 #include <algorithm>
+#include <utility>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <exception>
 
 #include "job.h"
 #include "concepts.h"
@@ -10,39 +15,50 @@
 namespace spool::detail
 {
 
-	//we're putting up with this awkward mess until we can get the extended range views in c++23
-	template<std::ranges::forward_range R>
-	std::vector<std::ranges::take_view<std::ranges::drop_view<std::ranges::ref_view<R>>>> split_range(R& range, size_t max_chunks)
+	//where each chunk starts and how long it is, when splitting size elements into at most max_chunks nearly equal chunks
+	inline std::vector<std::pair<size_t, size_t>> chunk_bounds(size_t size, size_t max_chunks)
 	{
-		std::vector<std::ranges::take_view<std::ranges::drop_view<std::ranges::ref_view<R>>>> views;
+		std::vector<std::pair<size_t, size_t>> chunks;
 
-		//if there's more chunks than elements in the range, return one chunk per element
-		if (max_chunks >= std::ranges::size(range))
+		//if there's more chunks than elements, one chunk per element
+		if (max_chunks >= size)
 		{
-			for (int i = 0; i < std::ranges::size(range); i++)
+			for (size_t i = 0; i < size; i++)
 			{
-				views.emplace_back(range | std::views::drop(i) | std::views::take(1));
+				chunks.emplace_back(i, 1);
 			}
 		}
 		else
 		{
 			//subdivide as normal
-			size_t chunk_size = std::ranges::size(range) / max_chunks;
-			size_t chunk_extra = std::ranges::size(range) % max_chunks;
+			size_t chunk_size = size / max_chunks;
+			size_t chunk_extra = size % max_chunks;
 
 			size_t step = 0;
 			for (size_t i = 0; i < max_chunks; i++)
 			{
 				size_t chunk = chunk_size + ((i < chunk_extra) ? 1 : 0);
-				views.emplace_back(range | std::views::drop(step) | std::views::take(chunk));
+				chunks.emplace_back(step, chunk);
 				step += chunk;
 			}
 		}
+		return chunks;
+	}
+
+	//we're putting up with this awkward mess until we can get the extended range views in c++23
+	template<std::ranges::forward_range R>
+	std::vector<std::ranges::take_view<std::ranges::drop_view<std::ranges::ref_view<R>>>> split_range(R& range, size_t max_chunks)
+	{
+		std::vector<std::ranges::take_view<std::ranges::drop_view<std::ranges::ref_view<R>>>> views;
+		for (const auto& [start, length] : chunk_bounds(std::ranges::size(range), max_chunks))
+		{
+			views.emplace_back(range | std::views::drop(start) | std::views::take(length));
+		}
 		return views;
 	}
 	
 	template<typename F, typename ... Hs>
-	requires std::invocable<F, handle_underlying_type<Hs...>&>
+	requires std::invocable<F, handle_underlying_type<Hs>&...>
 	bool run_with_handles(const F& func, const Hs& ... handles)
 	{
 		const std::array<bool, sizeof...(Hs)> has{ handles.has()... };
@@ -59,14 +75,14 @@ namespace spool::detail
 	}
 
 	template<typename F, typename ... Ps>
-	requires std::invocable<F, provider_underlying_type<Ps...>&>
+	requires std::invocable<F, provider_underlying_type<Ps>&...>
 	bool run_with_providers(F& func, Ps& ... providers)
 	{
 		return run_with_handles(func, providers.get()...);
 	}
 
 	template<typename F, typename ... Ps>
-	requires std::invocable<F, provider_underlying_type<Ps...>&>
+	requires std::invocable<F, provider_underlying_type<Ps>&...>
 	std::function<bool()> create_shared_resource_job_func(F&& func, Ps&&... providers)
 	{
 		return[func = std::forward<F>(func), ... providers = std::forward<Ps>(providers)]()
@@ -74,4 +90,82 @@ namespace spool::detail
 			return run_with_providers(func, providers...);
 		};
 	}
+
+	//below this many elements sorting or merging isn't worth splitting up
+	constexpr size_t serial_sort_cutoff = size_t(1) << 14;
+
+	//how many of the first k elements of a stable merge of a and b come from a, found by binary search along the merge path
+	template<typename A, typename B, typename C>
+	size_t merge_path_split(A a, size_t a_size, B b, size_t b_size, size_t k, const C& comp)
+	{
+		size_t low = k > b_size ? k - b_size : 0;
+		size_t high = std::min(k, a_size);
+		while (low < high)
+		{
+			const size_t i = (low + high) / 2;
+			const size_t j = k - i;
+			//a's element only goes first if b's isn't strictly smaller, which is what keeps equal elements in order
+			if (j == 0 || std::invoke(comp, b[j - 1], a[i]))
+			{
+				high = i;
+			}
+			else
+			{
+				low = i + 1;
+			}
+		}
+		return low;
+	}
+
+	//searches are split into a few chunks per worker, so there are unstarted chunks left to cancel once a match turns up
+	constexpr size_t search_chunks_per_worker = 4;
+	//how many elements a search chunk checks between looking to see if it can stop
+	constexpr size_t search_grain = 1024;
+
+	//what the chunks of one parallel search share
+	struct search_state final
+	{
+		search_state(size_t size, size_t chunk_count)
+			:size(size), lowest(size), remaining(chunk_count), claimed(new std::atomic_flag[chunk_count]), chunks(chunk_count)
+		{}
+
+		//true once there's nothing left for a chunk at position to find, any match it could make would be later than one already found
+		//for any_of every match is as good as another, so everything stops at the first
+		template<bool any>
+		bool stopped(size_t position) const
+		{
+			const size_t found = lowest.load(std::memory_order_relaxed);
+			return any ? found != size : found <= position;
+		}
+
+		//records a match, returns false if there's already one at or before it
+		bool offer(size_t index)
+		{
+			size_t current = lowest.load(std::memory_order_relaxed);
+			while (index < current)
+			{
+				if (lowest.compare_exchange_weak(current, index, std::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//called once for every chunk, run or cancelled, true for the last one
+		bool finish_chunk()
+		{
+			return remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		}
+
+		const size_t size;
+		std::atomic_size_t lowest;
+		std::atomic_size_t remaining;
+		//set by whichever of a chunk's own job or a cancelling chunk gets to it first, the one that sets it finishes the chunk
+		std::unique_ptr<std::atomic_flag[]> claimed;
+		std::vector<std::weak_ptr<job>> chunks;
+		//the first exception a chunk's predicate threw, only read once every chunk is finished
+		std::exception_ptr error;
+		std::atomic_flag failed;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SPOOL_HAS_MAPPED_FILE 1
+#endif
+
+namespace spool::detail
+{
+#ifdef SPOOL_HAS_MAPPED_FILE
+	//chunks are at least this big, so that each job has enough to do to be worth scheduling
+	constexpr size_t min_mapped_chunk = size_t(1) << 20;
+
+	//a whole file mapped read only, unmapped once the last job using it lets go
+	//throws std::system_error if the file can't be opened or mapped, an empty file maps to nothing
+	class mapped_file final
+	{
+	public:
+		explicit mapped_file(const std::string& path)
+		{
+			const int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "spool couldn't open " + path);
+			}
+			struct stat info;
+			if (fstat(fd, &info) != 0)
+			{
+				const int error = errno;
+				close(fd);
+				throw std::system_error(error, std::generic_category(), "spool couldn't stat " + path);
+			}
+			if (info.st_size > 0)
+			{
+				void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping == MAP_FAILED)
+				{
+					const int error = errno;
+					close(fd);
+					throw std::system_error(error, std::generic_category(), "spool couldn't map " + path);
+				}
+				data = static_cast<const char*>(mapping);
+				size = static_cast<size_t>(info.st_size);
+				//chunks are read front to back, so let the kernel read ahead aggressively
+				madvise(mapping, size, MADV_SEQUENTIAL);
+			}
+			//the mapping keeps the file's contents reachable on its own
+			close(fd);
+		}
+
+		~mapped_file()
+		{
+			if (data != nullptr)
+			{
+				munmap(const_cast<char*>(data), size);
+			}
+		}
+
+		mapped_file(const mapped_file& other) = delete;
+		mapped_file(mapped_file&& other) = delete;
+
+		std::string_view contents() const
+		{
+			return { data, size };
+		}
+
+		//splits the file into roughly chunk_size pieces, each extended to end just after a delimiter so no record is cut in two
+		std::vector<std::string_view> split(size_t chunk_size, char delimiter) const
+		{
+			std::vector<std::string_view> chunks;
+			size_t start = 0;
+			while (start < size)
+			{
+				size_t end = size;
+				if (size - start > chunk_size)
+				{
+					const void* found = std::memchr(data + start + chunk_size - 1, delimiter, size - (start + chunk_size - 1));
+					end = found == nullptr ? size : static_cast<size_t>(static_cast<const char*>(found) - data) + 1;
+				}
+				chunks.emplace_back(data + start, end - start);
+				start = end;
+			}
+			return chunks;
+		}
+
+		//asks the kernel to start reading a chunk in before we get to it
+		void prefetch(std::string_view chunk) const
+		{
+			//madvise wants page aligned ranges, widen the chunk out to its pages
+			const uintptr_t first = reinterpret_cast<uintptr_t>(chunk.data()) & ~(page_size() - 1);
+			const uintptr_t last = reinterpret_cast<uintptr_t>(chunk.data() + chunk.size());
+			madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+		}
+
+		//drops a finished chunk's pages from our mapping, they stay in the page cache, so a huge file doesn't pile up in our resident set
+		void release(std::string_view chunk) const
+		{
+			//only pages wholly inside the chunk, its neighbours may still be reading the ones at either end
+			const uintptr_t first = (reinterpret_cast<uintptr_t>(chunk.data()) + page_size() - 1) & ~(page_size() - 1);
+			const uintptr_t last = reinterpret_cast<uintptr_t>(chunk.data() + chunk.size()) & ~(page_size() - 1);
+			if (first < last)
+			{
+				madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+			}
+		}
+
+	private:
+		static uintptr_t page_size()
+		{
+			static const uintptr_t size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+			return size;
+		}
+
+		const char* data = nullptr;
+		size_t size = 0;
+	};
+#endif
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <memory>
+#include <concepts>
+#include <cassert>
+#include <cstddef>
+
+#include "stats.h"
+#include "thread_pool.h"
+
+namespace spool
+{
+	//one T per worker of a pool, each on its own cache line, so jobs can accumulate into them without contending
+	//local() is only for the pool's own workers, combine and for_each are for once the jobs writing to it have finished
+	template<typename T>
+	class per_worker final
+	{
+	public:
+		explicit per_worker(const thread_pool& pool, const T& initial = T{})
+			:pool(pool), count(pool.worker_count()), slots(new slot[count])
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				slots[i].value = initial;
+			}
+		}
+
+		per_worker(const per_worker& other) = delete;
+		per_worker(per_worker&& other) = delete;
+
+		//the calling worker's own slot
+		T& local()
+		{
+			const size_t index = pool.current_worker_index();
+			assert(index < count && "per_worker::local called from outside its pool");
+			return slots[index].value;
+		}
+
+		T& operator[](size_t worker_index)
+		{
+			return slots[worker_index].value;
+		}
+
+		const T& operator[](size_t worker_index) const
+		{
+			return slots[worker_index].value;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		//folds every slot together with op, starting from the first
+		template<typename F>
+			requires std::invocable<F, const T&, const T&>
+		T combine(F op) const
+		{
+			T result = slots[0].value;
+			for (size_t i = 1; i < count; i++)
+			{
+				result = op(result, slots[i].value);
+			}
+			return result;
+		}
+
+		template<typename F>
+			requires std::invocable<F, T&>
+		void for_each(F func)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				func(slots[i].value);
+			}
+		}
+
+		template<typename F>
+			requires std::invocable<F, const T&>
+		void for_each(F func) const
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				func(slots[i].value);
+			}
+		}
+
+	private:
+		struct alignas(detail::cache_line_size) slot
+		{
+			T value;
+		};
+
+		const thread_pool& pool;
+		const size_t count;
+		std::unique_ptr<slot[]> slots;
+	};
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <concepts>
+#include <cassert>
+
+#include "concepts.h"
+#include "job.h"
+#include "thread_pool.h"
+
+namespace spool
+{
+	enum class stage_mode
+	{
+		//one token at a time, in the order the source produced them
+		serial_in_order,
+		//one token at a time, in whatever order they arrive
+		serial_out_of_order,
+		//any number of tokens at once
+		parallel
+	};
+
+	//a chain of stages that tokens flow through, fed by a serial source. At most max_in_flight tokens are live at once, each with its own reused buffer
+	template<std::default_initializable T>
+	class pipeline final
+	{
+	public:
+		template<typename F>
+			requires invoke_result<F, bool, T&>
+		pipeline(size_t max_in_flight, F&& source)
+			:source(std::forward<F>(source)),
+			tokens(max_in_flight)
+		{
+			assert(max_in_flight > 0);
+		}
+
+		//moving or copying would invalidate the running token jobs
+		pipeline(const pipeline& other) = delete;
+		pipeline(pipeline&& other) = delete;
+
+		template<typename F>
+			requires std::invocable<F, T&>
+		pipeline& add_stage(stage_mode mode, F&& work)
+		{
+			stages.emplace_back(mode, std::forward<F>(work));
+			return *this;
+		}
+
+		//starts feeding tokens through the pipeline, the returned job is done once the source is exhausted and every token has left the last stage
+		//the pipeline must outlive the returned job, and must not be run again until it is done
+		std::shared_ptr<job> run(thread_pool& pool)
+		{
+			next_seq = 0;
+			exhausted.clear();
+			failed.clear();
+			//a failed run can leave these set
+			source_busy.clear();
+			for (auto& s : stages)
+			{
+				s.next_seq.store(0, std::memory_order_relaxed);
+				s.busy.clear();
+			}
+
+			std::vector<std::shared_ptr<job>> token_jobs;
+			token_jobs.reserve(tokens.size());
+			for (size_t i = 0; i < tokens.size(); i++)
+			{
+				tokens[i].has_input = false;
+				token_jobs.push_back(pool.enqueue_job(std::function<bool()>([this, i]() {return advance(tokens[i]); })));
+			}
+			return pool.enqueue_job([]() {}, token_jobs);
+		}
+
+	private:
+		struct stage
+		{
+			template<typename F>
+			stage(stage_mode mode, F&& work)
+				:mode(mode),
+				work(std::forward<F>(work))
+			{}
+
+			stage_mode mode;
+			std::function<void(T&)> work;
+			std::atomic_size_t next_seq;
+			std::atomic_flag busy;
+		};
+
+		struct token
+		{
+			T buffer;
+			size_t seq = 0;
+			size_t stage_index = 0;
+			bool has_input = false;
+		};
+
+		//if the source or a stage throws, the pipeline stops taking input and the other tokens are dropped, the exception is carried by the token's job to the one returned from run
+		bool advance(token& t)
+		{
+			try
+			{
+				return advance_unguarded(t);
+			}
+			catch (...)
+			{
+				failed.test_and_set();
+				exhausted.test_and_set();
+				throw;
+			}
+		}
+
+		//pushes a token as far through the pipeline as it can go, returns true once the source is exhausted and this token has nothing left to do
+		//returning false leaves the job to be retried later, like any other job waiting on a resource
+		bool advance_unguarded(token& t)
+		{
+			while (true)
+			{
+				if (!t.has_input)
+				{
+					if (exhausted.test())
+					{
+						return true;
+					}
+					if (source_busy.test_and_set(std::memory_order_acquire))
+					{
+						//another token is pulling from the source
+						return false;
+					}
+					if (exhausted.test())
+					{
+						source_busy.clear(std::memory_order_release);
+						return true;
+					}
+					if (!source(t.buffer))
+					{
+						exhausted.test_and_set();
+						source_busy.clear(std::memory_order_release);
+						return true;
+					}
+					t.seq = next_seq++;
+					t.stage_index = 0;
+					t.has_input = true;
+					source_busy.clear(std::memory_order_release);
+				}
+
+				while (t.stage_index < stages.size())
+				{
+					if (failed.test())
+					{
+						//a stage further along may be left busy, or waiting on a token that will never come
+						return true;
+					}
+					stage& s = stages[t.stage_index];
+					switch (s.mode)
+					{
+					case stage_mode::parallel:
+						s.work(t.buffer);
+						break;
+					case stage_mode::serial_in_order:
+						if (s.next_seq.load(std::memory_order_acquire) != t.seq)
+						{
+							//an earlier token hasn't cleared this stage yet
+							return false;
+						}
+						s.work(t.buffer);
+						s.next_seq.store(t.seq + 1, std::memory_order_release);
+						break;
+					case stage_mode::serial_out_of_order:
+						if (s.busy.test_and_set(std::memory_order_acquire))
+						{
+							return false;
+						}
+						s.work(t.buffer);
+						s.busy.clear(std::memory_order_release);
+						break;
+					}
+					t.stage_index++;
+				}
+
+				//token has left the last stage, its buffer is free for the next input
+				t.has_input = false;
+			}
+		}
+
+		std::function<bool(T&)> source;
+		std::deque<stage> stages;
+		std::vector<token> tokens;
+		size_t next_seq = 0;
+		std::atomic_flag source_busy;
+		std::atomic_flag exhausted;
+		std::atomic_flag failed;
+	};
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <memory_resource>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "stats.h"
+
+namespace spool
+{
+	namespace detail
+	{
+		constexpr size_t initial_scratch_size = size_t(64) << 10;
+	}
+
+	//a bump allocator for memory that only lives as long as a job, each worker has one, reset whenever a job finishes
+	//allocating is a pointer bump and freeing does nothing, so it must only be used from the worker's own thread
+	class scratch_arena final
+	{
+	public:
+		scratch_arena() = default;
+
+		~scratch_arena()
+		{
+			release();
+		}
+
+		scratch_arena(const scratch_arena& other) = delete;
+		scratch_arena(scratch_arena&& other) = delete;
+
+		void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+		{
+			uintptr_t start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			if (start + bytes > limit || cursor == 0)
+			{
+				//out of room, start a new block big enough for this and then some, the old ones stay put until the next reset
+				add_block(std::max(bytes + alignment, blocks.empty() ? detail::initial_scratch_size : blocks.back().size * 2));
+				start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			}
+			cursor = start + bytes;
+			return reinterpret_cast<void*>(start);
+		}
+
+		template<typename T>
+		T* allocate(size_t count = 1)
+		{
+			return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		//forgets everything allocated so far, if that took more than one block they're merged into one big enough for next time
+		void reset()
+		{
+			if (blocks.size() > 1)
+			{
+				size_t total = 0;
+				for (const auto& b : blocks)
+				{
+					total += b.size;
+				}
+				release();
+				add_block(total);
+			}
+			else if (!blocks.empty())
+			{
+				cursor = blocks.front().start;
+			}
+		}
+
+		//allocates the first block, called from the worker's own thread so the memory lands on its node
+		void reserve(size_t bytes = detail::initial_scratch_size)
+		{
+			if (blocks.empty())
+			{
+				add_block(bytes);
+			}
+		}
+
+		//bytes handed out since the last reset
+		size_t used() const
+		{
+			size_t total = 0;
+			for (size_t i = 0; i + 1 < blocks.size(); i++)
+			{
+				total += blocks[i].size;
+			}
+			return blocks.empty() ? 0 : total + (cursor - blocks.back().start);
+		}
+
+		size_t capacity() const
+		{
+			size_t total = 0;
+			for (const auto& b : blocks)
+			{
+				total += b.size;
+			}
+			return total;
+		}
+
+		//for standard containers, std::pmr::vector<int> v(scratch->resource());
+		std::pmr::memory_resource* resource()
+		{
+			return &adapter;
+		}
+
+	private:
+		struct block
+		{
+			uintptr_t start;
+			size_t size;
+		};
+
+		class pmr_adapter final : public std::pmr::memory_resource
+		{
+		public:
+			explicit pmr_adapter(scratch_arena& owner)
+				:owner(owner)
+			{}
+
+		private:
+			void* do_allocate(size_t bytes, size_t alignment) override
+			{
+				return owner.allocate(bytes, alignment);
+			}
+
+			void do_deallocate(void*, size_t, size_t) override
+			{}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+			{
+				return this == &other;
+			}
+
+			scratch_arena& owner;
+		};
+
+		void add_block(size_t bytes)
+		{
+			void* memory = ::operator new(bytes, std::align_val_t(detail::cache_line_size));
+			blocks.push_back({ reinterpret_cast<uintptr_t>(memory), bytes });
+			cursor = blocks.back().start;
+			limit = cursor + bytes;
+		}
+
+		void release()
+		{
+			for (const auto& b : blocks)
+			{
+				::operator delete(reinterpret_cast<void*>(b.start), std::align_val_t(detail::cache_line_size));
+			}
+			blocks.clear();
+			cursor = 0;
+			limit = 0;
+		}
+
+		std::vector<block> blocks;
+		uintptr_t cursor = 0;
+		uintptr_t limit = 0;
+		pmr_adapter adapter{ *this };
+	};
+}
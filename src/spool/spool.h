@@ -1,4 +1,8 @@
 #pragma once
 #include "thread_pool.h"
 #include "job.h"
-#include "shared_resource.h"
\ No newline at end of file
+#include "shared_resource.h"
+#include "pipeline.h"
+#include "per_worker.h"
+#include "concurrent_map.h"
+#include "execution.h"
\ No newline at end of file
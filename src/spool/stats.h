@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace spool
+{
+	namespace detail
+	{
+		constexpr size_t cache_line_size = 64;
+
+#ifndef SPOOL_DISABLE_STATS
+		constexpr bool stats_enabled = true;
+
+		//a counter only ever written by its owning worker, so it can skip the locked read-modify-write
+		class counter final
+		{
+		public:
+			void add(uint64_t n = 1)
+			{
+				value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+			}
+
+			uint64_t get() const
+			{
+				return value.load(std::memory_order_relaxed);
+			}
+
+		private:
+			std::atomic_uint64_t value = 0;
+		};
+#else
+		constexpr bool stats_enabled = false;
+
+		class counter final
+		{
+		public:
+			void add(uint64_t = 1)
+			{}
+
+			uint64_t get() const
+			{
+				return 0;
+			}
+		};
+#endif // !SPOOL_DISABLE_STATS
+
+		//kept on its own cache line so that counting never contends with stealers touching the worker's queue
+		struct alignas(cache_line_size) worker_counters final
+		{
+			counter jobs_executed;
+			counter jobs_held;
+			counter held_requeued;
+			counter unassigned_pops;
+			counter steal_attempts;
+			counter steals;
+			counter idle_ns;
+			counter jobs_parked;
+			counter handoffs;
+			counter jobs_inlined;
+		};
+	}
+
+	struct worker_stats final
+	{
+		//jobs that ran to completion
+		uint64_t jobs_executed = 0;
+		//attempts that couldn't run yet and were held back by the worker
+		uint64_t jobs_held = 0;
+		//held jobs pushed back onto the worker's queue
+		uint64_t held_requeued = 0;
+		//jobs taken from the pool's unassigned queue
+		uint64_t unassigned_pops = 0;
+		uint64_t steal_attempts = 0;
+		uint64_t steals = 0;
+		//time spent spinning in next_job without finding anything
+		std::chrono::nanoseconds idle_time{ 0 };
+		//attempts that were parked on the prerequisite blocking them instead of being held
+		uint64_t jobs_parked = 0;
+		//parked jobs run straight after their prerequisite, without going through a queue
+		uint64_t handoffs = 0;
+		//jobs marked may_inline that were run on the spot by the worker enqueuing them
+		uint64_t jobs_inlined = 0;
+		//jobs in the worker's queue when the snapshot was taken
+		size_t queue_depth = 0;
+		//the worker's queue's capacity, and the arrays left over from resizing it that aren't yet freed
+		size_t queue_capacity = 0;
+		size_t retired_arrays = 0;
+
+		worker_stats& operator+=(const worker_stats& other)
+		{
+			jobs_executed += other.jobs_executed;
+			jobs_held += other.jobs_held;
+			held_requeued += other.held_requeued;
+			unassigned_pops += other.unassigned_pops;
+			steal_attempts += other.steal_attempts;
+			steals += other.steals;
+			idle_time += other.idle_time;
+			jobs_parked += other.jobs_parked;
+			handoffs += other.handoffs;
+			jobs_inlined += other.jobs_inlined;
+			queue_depth += other.queue_depth;
+			queue_capacity += other.queue_capacity;
+			retired_arrays += other.retired_arrays;
+			return *this;
+		}
+
+		//the activity between an earlier snapshot and this one, depth and capacity are kept as of this snapshot
+		worker_stats operator-(const worker_stats& earlier) const
+		{
+			worker_stats delta = *this;
+			delta.jobs_executed -= earlier.jobs_executed;
+			delta.jobs_held -= earlier.jobs_held;
+			delta.held_requeued -= earlier.held_requeued;
+			delta.unassigned_pops -= earlier.unassigned_pops;
+			delta.steal_attempts -= earlier.steal_attempts;
+			delta.steals -= earlier.steals;
+			delta.idle_time -= earlier.idle_time;
+			delta.jobs_parked -= earlier.jobs_parked;
+			delta.handoffs -= earlier.handoffs;
+			delta.jobs_inlined -= earlier.jobs_inlined;
+			return delta;
+		}
+	};
+
+	struct pool_stats final
+	{
+		std::vector<worker_stats> workers;
+		//jobs waiting in the pool's unassigned and per-node queues when the snapshot was taken
+		size_t unassigned_depth = 0;
+
+		worker_stats total() const
+		{
+			worker_stats sum;
+			for (const auto& w : workers)
+			{
+				sum += w;
+			}
+			return sum;
+		}
+
+		pool_stats operator-(const pool_stats& earlier) const
+		{
+			pool_stats delta = *this;
+			for (size_t i = 0; i < delta.workers.size() && i < earlier.workers.size(); i++)
+			{
+				delta.workers[i] = workers[i] - earlier.workers[i];
+			}
+			return delta;
+		}
+	};
+}
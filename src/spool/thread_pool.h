@@ -7,6 +7,15 @@
 #include <array>
 #include <type_traits>
 #include <cassert>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <utility>
 
 #include "concepts.h"
 #include "wsq.h"
@@ -14,6 +23,14 @@
 #include "job.h"
 #include "job_utils.h"
 #include "input_data.h"
+#include "stats.h"
+#include "histogram.h"
+#include "trace.h"
+#include "topology.h"
+#include "arena.h"
+#include "async_io.h"
+#include "mapped_file.h"
+#include "scratch.h"
 
 #ifndef __cpp_lib_ranges
 #error "Spool requires a complete (or near complete) ranges implementation, check your compiler settings"
@@ -24,6 +41,7 @@ namespace spool
 
 	constexpr size_t max_unassigned_jobs = 2056;
 	constexpr size_t max_assigned_jobs = 1024;
+	constexpr size_t max_mailbox_jobs = 1024;
 
 	namespace detail
 	{
@@ -32,18 +50,62 @@ namespace spool
 			thread_pool* pool;
 			size_t runner_index;
 		};
+
+		//an unbounded spill for a bounded queue, used by workers that can't wait for room since whoever frees it might be waiting on them
+		class overflow_queue final
+		{
+		public:
+			void push(std::shared_ptr<job> spilled)
+			{
+				std::scoped_lock hold(lock);
+				jobs.push_back(std::move(spilled));
+				count.store(jobs.size(), std::memory_order_release);
+			}
+
+			bool try_pop(std::shared_ptr<job>& popped)
+			{
+				//checked without the lock first, it's nearly always empty
+				if (count.load(std::memory_order_acquire) == 0)
+				{
+					return false;
+				}
+				std::scoped_lock hold(lock);
+				if (jobs.empty())
+				{
+					return false;
+				}
+				popped = std::move(jobs.front());
+				jobs.pop_front();
+				count.store(jobs.size(), std::memory_order_release);
+				return true;
+			}
+
+			bool empty() const
+			{
+				return count.load(std::memory_order_acquire) == 0;
+			}
+
+		private:
+			std::mutex lock;
+			std::deque<std::shared_ptr<job>> jobs;
+			std::atomic_size_t count = 0;
+		};
 	}
 
 	struct execution_context final
 	{
 		thread_pool* pool;
 		std::shared_ptr<job> active_job;
+		//the index of the worker running the job, can be passed as job_options::worker to keep children on the same worker
+		size_t runner_index;
+		//the worker's scratch memory, anything allocated from it is gone once the job finishes
+		scratch_arena* scratch;
 	};
 
 	template<typename T>
 	struct [[nodiscard]] data_job final
 	{
-		std::shared_ptr<job> job;
+		std::shared_ptr<spool::job> job;
 		std::shared_ptr<input_data<T>> data;
 	};
 	
@@ -52,24 +114,159 @@ namespace spool
 		attached_and_ran, already_worker, max_already_attached
 	};
 
+	enum class worker_placement
+	{
+		//leave scheduling entirely to the os
+		unpinned,
+		//pin each worker thread to its own core, alternating between numa nodes, before doubling up on hyperthreads
+		spread
+	};
+
+	struct worker_group_options final
+	{
+		std::string name;
+		//the worker indices in the group, thread workers first, then compensation slots, then attachable workers
+		std::vector<size_t> members;
+	};
+
+	struct pool_options final
+	{
+		unsigned int thread_count = std::thread::hardware_concurrency();
+		unsigned int attachable_workers = 0;
+		worker_placement placement = worker_placement::unpinned;
+		//explicit cpus to pin each worker thread to, in worker order, overrides placement when given
+		std::vector<std::vector<unsigned int>> cpu_sets{};
+		//bounds on the number of worker threads, 0 means the same as thread_count, so by default the pool doesn't grow or shrink
+		unsigned int min_threads = 0;
+		unsigned int max_threads = 0;
+		//an elastic pool retires a worker thread that has found nothing to do for this long, down to min_threads
+		std::chrono::milliseconds idle_timeout{ 1000 };
+		//an elastic pool adds a worker thread when none are idle and at least this many jobs are waiting, up to max_threads
+		size_t grow_backlog = 64;
+		//named sets of workers that jobs can be restricted to
+		std::vector<worker_group_options> worker_groups{};
+		//shrink a worker's queue back down once it runs dry after a burst has grown it
+		bool shrink_queues = true;
+		//how deep a worker's queue has to be before it runs jobs marked may_inline as it enqueues them
+		size_t inline_threshold = max_assigned_jobs / 4;
+		//extra worker slots for standing in while workers are stuck in a blocking_region, with none a blocking_region does nothing
+		unsigned int compensation_threads = 0;
+	};
+
+	//marks a stretch of a job that blocks without using the cpu, such as a read from a pipe
+	//for as long as it's in scope the pool runs a stand-in worker, so that the number of workers actually doing work stays the same
+	class blocking_region final
+	{
+	public:
+		blocking_region();
+		~blocking_region();
+
+		blocking_region(const blocking_region& other) = delete;
+		blocking_region& operator=(const blocking_region& other) = delete;
+
+	private:
+		thread_pool* pool;
+		//the compensation slot started for us, if any
+		size_t slot;
+	};
+
+	namespace detail
+	{
+		//runs all of a job's work inside a blocking_region, keeping retryable work retryable
+		template<job_func F>
+		auto blocking_job_func(F&& work)
+		{
+			if constexpr (std::same_as<std::remove_cvref_t<F>, std::function<bool()>>)
+			{
+				return std::function<bool()>([work = std::forward<F>(work)]() { blocking_region region; return work(); });
+			}
+			else
+			{
+				return [work = std::forward<F>(work)]() mutable { blocking_region region; work(); };
+			}
+		}
+	}
+
 	class thread_pool final
 	{
+		friend blocking_region;
 	public:
 
 		thread_pool(unsigned int thread_count = std::thread::hardware_concurrency(), unsigned int attachable_workers = 0)
+			:thread_pool(make_options(thread_count, attachable_workers))
+		{}
+
+		explicit thread_pool(const pool_options& options)
 			:unassigned_jobs(max_unassigned_jobs),
-			unattached_workers(attachable_workers)
+			unattached_workers(options.attachable_workers),
+			min_threads(options.min_threads == 0 ? options.thread_count : std::min(options.min_threads, options.thread_count)),
+			max_threads(std::max(options.max_threads, options.thread_count)),
+			compensation_threads(options.compensation_threads),
+			idle_timeout(options.idle_timeout),
+			grow_backlog(options.grow_backlog),
+			inline_threshold(options.inline_threshold)
 		{
-			assert(thread_count >= 0);
-			assert(attachable_workers >= 0);
+			const unsigned int thread_count = options.thread_count;
+			const unsigned int attachable_workers = options.attachable_workers;
+			shrink_queues = options.shrink_queues;
 			assert(thread_count + attachable_workers > 0);
-			for (unsigned int i = 0; i < thread_count + attachable_workers; i++)
+			assert(min_threads > 0 || attachable_workers > 0 || thread_count == 0);
+			elastic = min_threads != max_threads;
+
+			const auto& topology = detail::cpu_topology::get();
+			const bool pinned = !options.cpu_sets.empty() || options.placement == worker_placement::spread;
+			node_count = pinned ? topology.node_count() : 1;
+			for (size_t node = 0; node < node_count; node++)
+			{
+				node_jobs.emplace_back(max_unassigned_jobs);
+			}
+
+			//every slot a worker could ever occupy is created up front, so the array never moves under stealers
+			for (unsigned int i = 0; i < max_threads + compensation_threads + attachable_workers; i++)
+			{
+				worker& w = workers.emplace_back(i);
+				if (i >= max_threads || !pinned)
+				{
+					//attached threads belong to the caller, so we leave their affinity alone, stand-ins just take whatever cpu the blocked worker left free
+					w.node = pinned ? i % node_count : 0;
+				}
+				else if (!options.cpu_sets.empty())
+				{
+					w.cpus = options.cpu_sets[i % options.cpu_sets.size()];
+					w.node = w.cpus.empty() ? 0 : topology.node_of(w.cpus.front());
+				}
+				else
+				{
+					//round robin across nodes, then across cores within each node
+					w.node = i % node_count;
+					const auto& cpus = topology.cpus(w.node);
+					w.cpus = { cpus[(i / node_count) % cpus.size()] };
+				}
+			}
+			build_steal_orders();
+			for (auto& w : workers)
+			{
+				w.work_queue.set_epoch(&reclaim_epoch);
+			}
+
+			for (const auto& group : options.worker_groups)
 			{
-				workers.emplace_back(i);
+				const size_t group_index = worker_groups.size();
+				worker_groups.push_back(group);
+				group_jobs.emplace_back(max_mailbox_jobs);
+				group_overflow.emplace_back();
+				for (const size_t member : group.members)
+				{
+					assert(member < workers.size());
+					workers[member].groups.push_back(group_index);
+				}
 			}
+
+			child_threads.resize(max_threads + compensation_threads);
+			std::scoped_lock lock(resize_lock);
 			for (unsigned int i = 0; i < thread_count; i++)
 			{
-				child_threads.emplace_back(run_worker, this, i);
+				start_thread(i);
 			}
 		}
 
@@ -94,7 +291,10 @@ namespace spool
 			{
 				return attach_result::max_already_attached;
 			}
-			workers.at(workers.size() - attachment).run(this);
+			worker& slot = workers.at(workers.size() - attachment);
+			slot.state.store(worker_state::running, std::memory_order_release);
+			slot.run(this);
+			slot.state.store(worker_state::inactive, std::memory_order_release);
 			thread_pool::context.pool = nullptr;
 			return attach_result::attached_and_ran;
 		}
@@ -102,17 +302,19 @@ namespace spool
 #pragma region base_job
 
 		template<job_func F>
-		std::shared_ptr<job> enqueue_job(F&& work)
+		std::shared_ptr<job> enqueue_job(F&& work, const job_options& options = {})
 		{
-			const std::shared_ptr<job> pjob(new job(std::forward<std::function<void()>>(work)));
+			const std::shared_ptr<job> pjob(new job(std::forward<F>(work)));
+			pjob->options = options;
 			enqueue_job(pjob);
 			return pjob;
 		}
 
 		template<job_func F, usable_prerequisite P>
-		std::shared_ptr<job> enqueue_job(F&& work, P&& prerequisite)
+		std::shared_ptr<job> enqueue_job(F&& work, P&& prerequisite, const job_options& options = {})
 		{
-			const std::shared_ptr<job> pjob(new job(std::forward<std::function<void()>>(work), std::forward<P>(prerequisite)));
+			const std::shared_ptr<job> pjob(new job(std::forward<F>(work), std::forward<P>(prerequisite)));
+			pjob->options = options;
 			enqueue_job(pjob);
 			return pjob;
 		}
@@ -157,7 +359,50 @@ namespace spool
 			return enqueue_job(detail::create_shared_resource_job_func<F, Ps ...>(std::forward<F>(func), std::forward<Ps>(providers)...), std::forward<Pr>(prerequisite));
 		}
 		
+#ifdef SPOOL_HAS_FILE_IO
+#pragma region async_io
+
+		//reads from a file without holding up a worker, then runs work with the result, the buffer must stay alive until the job is done
+		//on linux the read goes through an io_uring whose completions workers reap between jobs, elsewhere it's a blocking job
+		template<typename F>
+			requires std::invocable<F, file_read&>
+		data_job<file_read> read_file_async(int fd, uint64_t offset, std::span<std::byte> buffer, F&& work)
+		{
+			data_job<file_read> read = enqueue_data_job<file_read>(std::forward<F>(work));
+			start_read(fd, offset, buffer, read.data);
+			return read;
+		}
+
+		//as above, with a job that's simply done once the read is, the result can be had through the data handle
+		data_job<file_read> read_file_async(int fd, uint64_t offset, std::span<std::byte> buffer)
+		{
+			return read_file_async(fd, offset, buffer, [](const file_read&) {});
+		}
+
+		//reads submitted to the pool's ring that haven't completed yet
+		size_t reads_in_flight() const
+		{
+			return io_in_flight.load(std::memory_order_relaxed);
+		}
+
+#pragma endregion async_io
+#endif
+
 #pragma region impl_helpers
+		//splits count elements into chunks the same way for_each does, and runs work(begin, end) on each as its own job
+		//max_chunks defaults to one per worker, asking for more gives finer grained load balancing
+		template<std::copy_constructible F>
+			requires std::invocable<const F&, size_t, size_t>
+		std::vector<std::shared_ptr<job>> for_each_chunk(size_t count, const F& work, size_t max_chunks = 0)
+		{
+			std::vector<std::shared_ptr<job>> jobs;
+			for (const auto& [start, length] : detail::chunk_bounds(count, max_chunks == 0 ? workers.size() : max_chunks))
+			{
+				jobs.emplace_back(enqueue_job([=, end = start + length]() {work(start, end); }));
+			}
+			return jobs;
+		}
+
 		template<std::ranges::forward_range R, std::copy_constructible F>
 			requires std::invocable<F, range_underlying<R>&>
 		std::vector<std::shared_ptr<job>> for_each(R& range, const F& work)
@@ -178,6 +423,86 @@ namespace spool
 			std::ranges::for_each(chunks, [&](auto& chunk) {jobs.emplace_back(enqueue_job([=]() {std::ranges::for_each(chunk, work); }, prerequisite)); });
 			return jobs;
 		}
+
+		//sorts the range with a parallel merge sort, the returned job is done once it's sorted, the range must outlive it
+		//pieces are sorted serially and then merged pairwise, ping-ponging through one scratch buffer allocated up front
+		//ranges too small to split, or of elements that can't be default constructed into a buffer, are sorted by a single job
+		template<std::ranges::random_access_range R, std::copy_constructible C = std::ranges::less>
+			requires std::ranges::sized_range<R> && std::sortable<std::ranges::iterator_t<R>, C>
+		std::shared_ptr<job> parallel_sort(R& range, C comp = {})
+		{
+			return merge_sort<false>(range, comp);
+		}
+
+		//as parallel_sort, but equal elements keep their order
+		template<std::ranges::random_access_range R, std::copy_constructible C = std::ranges::less>
+			requires std::ranges::sized_range<R> && std::sortable<std::ranges::iterator_t<R>, C>
+		std::shared_ptr<job> parallel_stable_sort(R& range, C comp = {})
+		{
+			return merge_sort<true>(range, comp);
+		}
+
+		//finds the lowest index element matching pred, the data job gets the index once the search is over, or the range's size if nothing matched
+		//chunks look for a match before them every so often and stop once there is one, chunks after it that haven't started are cancelled
+		template<std::ranges::random_access_range R, std::copy_constructible P, typename F>
+			requires std::ranges::sized_range<R> && std::predicate<const P&, std::ranges::range_reference_t<R>> && std::invocable<F, size_t&>
+		data_job<size_t> parallel_find_if(R& range, const P& pred, F&& work)
+		{
+			return search<false>(range, pred, std::forward<F>(work));
+		}
+
+		template<std::ranges::random_access_range R, std::copy_constructible P>
+			requires std::ranges::sized_range<R> && std::predicate<const P&, std::ranges::range_reference_t<R>>
+		data_job<size_t> parallel_find_if(R& range, const P& pred)
+		{
+			return parallel_find_if(range, pred, [](const size_t&) {});
+		}
+
+		//whether any element matches pred, as parallel_find_if but every chunk stops and every unstarted one is cancelled at the first match found
+		template<std::ranges::random_access_range R, std::copy_constructible P, typename F>
+			requires std::ranges::sized_range<R> && std::predicate<const P&, std::ranges::range_reference_t<R>> && std::invocable<F, bool&>
+		data_job<bool> parallel_any_of(R& range, const P& pred, F&& work)
+		{
+			return search<true>(range, pred, std::forward<F>(work));
+		}
+
+		template<std::ranges::random_access_range R, std::copy_constructible P>
+			requires std::ranges::sized_range<R> && std::predicate<const P&, std::ranges::range_reference_t<R>>
+		data_job<bool> parallel_any_of(R& range, const P& pred)
+		{
+			return parallel_any_of(range, pred, [](const bool&) {});
+		}
+
+#ifdef SPOOL_HAS_MAPPED_FILE
+		//maps a file and calls work on chunks of it in parallel, each chunk a run of whole records ending in the delimiter, or the end of the file
+		//nothing is copied, the mapping stays alive until the last chunk is done, returns no jobs if the file is empty
+		//throws std::system_error if the file can't be opened or mapped, before any job is enqueued
+		template<std::copy_constructible F>
+			requires std::invocable<F, std::string_view>
+		std::vector<std::shared_ptr<job>> parallel_for_mapped_file(const std::string& path, const F& work, char delimiter = '\n')
+		{
+			const auto file = std::make_shared<detail::mapped_file>(path);
+			const size_t chunk_size = std::max(detail::min_mapped_chunk, file->contents().size() / (workers.size() * 4));
+			const std::vector<std::string_view> chunks = file->split(chunk_size, delimiter);
+			std::vector<std::shared_ptr<job>> jobs;
+			if (!chunks.empty())
+			{
+				file->prefetch(chunks.front());
+			}
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				const std::string_view next = i + 1 < chunks.size() ? chunks[i + 1] : std::string_view();
+				jobs.emplace_back(enqueue_job([=, chunk = chunks[i]]()
+					{
+						//get the disk going on whatever's likely to be wanted next while we work through this one
+						if (!next.empty()) file->prefetch(next);
+						work(chunk);
+						file->release(chunk);
+					}));
+			}
+			return jobs;
+		}
+#endif
 #pragma endregion impl_helpers
 
 
@@ -185,21 +510,264 @@ namespace spool
         {
             if (thread_pool::context.pool != nullptr)
             {
-                return { thread_pool::context.pool, thread_pool::context.pool->workers[thread_pool::context.runner_index].active_job };
+                worker& w = thread_pool::context.pool->workers[thread_pool::context.runner_index];
+                return { thread_pool::context.pool, w.active_job, thread_pool::context.runner_index, &w.scratch };
             }
-            else return { nullptr, nullptr };
+            else return { nullptr, nullptr, SIZE_MAX, nullptr };
         }
 
+#pragma region elastic
+
+		//the number of worker threads currently running, not counting attached threads
+		unsigned int thread_count() const
+		{
+			return active_threads.load(std::memory_order_relaxed);
+		}
+
+		//grows or shrinks the pool towards the given number of worker threads, clamped to the pool's bounds, and returns the new target
+		//shrinking lets the retired workers finish their current job and hand their queued work back to the pool
+		unsigned int resize(unsigned int target)
+		{
+			target = std::clamp(target, min_threads, max_threads);
+			std::scoped_lock lock(resize_lock);
+			if (exiting.test())
+			{
+				return active_threads.load();
+			}
+			for (size_t i = 0; i < max_threads && active_threads.load() < target; i++)
+			{
+				if (workers[i].state.load(std::memory_order_acquire) == worker_state::inactive)
+				{
+					start_thread(i);
+				}
+			}
+			for (size_t i = max_threads; i > 0 && active_threads.load() > target; i--)
+			{
+				worker_state expected = worker_state::running;
+				if (workers[i - 1].state.compare_exchange_strong(expected, worker_state::retiring))
+				{
+					active_threads--;
+				}
+			}
+			return target;
+		}
+
+		//resizes the pool to match the cpu quota the process is currently allowed, if there is one, and returns the new target
+		unsigned int fit_to_cpu_quota()
+		{
+			const double quota = detail::cpu_quota();
+			if (quota <= 0)
+			{
+				return active_threads.load();
+			}
+			return resize(static_cast<unsigned int>(std::ceil(quota)));
+		}
+
+		//stand-in threads currently running for workers inside a blocking_region
+		unsigned int compensating_thread_count() const
+		{
+			unsigned int count = 0;
+			for (size_t i = max_threads; i < max_threads + compensation_threads; i++)
+			{
+				if (workers[i].state.load(std::memory_order_relaxed) != worker_state::inactive) count++;
+			}
+			return count;
+		}
+
+		template<job_func F>
+		std::shared_ptr<job> enqueue_blocking_job(F&& work, const job_options& options = {})
+		{
+			return enqueue_job(detail::blocking_job_func(std::forward<F>(work)), options);
+		}
+
+		template<job_func F, usable_prerequisite P>
+		std::shared_ptr<job> enqueue_blocking_job(F&& work, P&& prerequisite, const job_options& options = {})
+		{
+			return enqueue_job(detail::blocking_job_func(std::forward<F>(work)), std::forward<P>(prerequisite), options);
+		}
+
+#pragma endregion elastic
+
+		//every worker slot the pool has, thread, stand-in and attachable alike, a runner_index is always below this
+		size_t worker_count() const
+		{
+			return workers.size();
+		}
+
+		//the calling thread's worker index in this pool, or SIZE_MAX if it isn't one of this pool's workers, cheaper than get_execution_context
+		size_t current_worker_index() const
+		{
+			return context.pool == this ? context.runner_index : SIZE_MAX;
+		}
+
+		//the number of numa nodes workers are spread over, always 1 for unpinned pools
+		size_t nodes() const
+		{
+			return node_count;
+		}
+
+		//creates an arena that shares this pool's workers, it lives as long as the pool
+		arena& create_arena(const arena_options& options = {})
+		{
+			std::scoped_lock lock(arena_lock);
+			const size_t index = arena_count.load(std::memory_order_relaxed);
+			assert(index < detail::max_arenas);
+			arenas[index].reset(new arena(options));
+			//workers only look at arenas below the count, so publish it once the arena is in place
+			arena_count.store(index + 1, std::memory_order_release);
+			return *arenas[index];
+		}
+
+		//the index of the named worker group, for use as job_options::group, or no_group if there isn't one
+		size_t group(std::string_view name) const
+		{
+			for (size_t i = 0; i < worker_groups.size(); i++)
+			{
+				if (worker_groups[i].name == name)
+				{
+					return i;
+				}
+			}
+			return no_group;
+		}
+
+		//the numa node a worker was placed on
+		size_t worker_node(size_t worker_index) const
+		{
+			return workers[worker_index].node;
+		}
+
+		//a snapshot of every worker's counters, subtract an earlier snapshot to get the activity in between
+		pool_stats stats() const
+		{
+			pool_stats snapshot;
+			snapshot.workers.reserve(workers.size());
+			for (const auto& w : workers)
+			{
+				snapshot.workers.push_back(w.stats());
+			}
+			auto depth = unassigned_jobs.size();
+			for (const auto& queue : node_jobs)
+			{
+				depth += queue.size();
+			}
+			depth += arena_backlog();
+			snapshot.unassigned_depth = depth > 0 ? static_cast<size_t>(depth) : 0;
+			return snapshot;
+		}
+
+		//latency is only measured for jobs enqueued while it's switched on, since it costs a few clock reads per job
+		void start_latency()
+		{
+			measuring_latency.store(true, std::memory_order_relaxed);
+		}
+
+		void stop_latency()
+		{
+			measuring_latency.store(false, std::memory_order_relaxed);
+		}
+
+		//a snapshot of every worker's latency histograms, subtract an earlier snapshot to get the latencies in between, or total() to merge them
+		pool_latency latency() const
+		{
+			pool_latency snapshot;
+			snapshot.workers.reserve(workers.size());
+			for (const auto& w : workers)
+			{
+				snapshot.workers.push_back(w.latency.snapshot());
+			}
+			return snapshot;
+		}
+
+#pragma region tracing
+
+		//starts recording a timeline of every job run, call from one controlling thread only
+		void start_trace()
+		{
+			if (!trace_rings_ready)
+			{
+				for (auto& w : workers)
+				{
+					w.trace = std::make_unique<detail::trace_ring>();
+				}
+				trace_start = std::chrono::steady_clock::now();
+				trace_rings_ready = true;
+			}
+			tracing.store(true, std::memory_order_release);
+		}
+
+		void stop_trace()
+		{
+			tracing.store(false, std::memory_order_relaxed);
+		}
+
+		//flushes everything recorded since the last write as chrome trace_event json, which chrome://tracing and perfetto can both open
+		//events a worker couldn't record because its ring was full are counted in otherData, a non zero count means the timeline has gaps
+		void write_trace(std::ostream& out)
+		{
+			out << "{\"traceEvents\":[";
+			bool first = true;
+			uint64_t dropped = 0;
+			for (auto& w : workers)
+			{
+				if (!first) out << ',';
+				first = false;
+				out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << w.worker_index
+					<< ",\"args\":{\"name\":\"worker " << w.worker_index << "\"}}";
+				if (w.trace == nullptr) continue;
+				w.trace->drain([&](const detail::trace_event& event)
+					{
+						out << ',';
+						detail::write_trace_event(out, event, w.worker_index);
+					});
+				dropped += w.trace->take_dropped();
+			}
+			out << "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << dropped << "}}";
+		}
+
+		bool write_trace(const std::string& path)
+		{
+			std::ofstream file(path);
+			if (!file)
+			{
+				return false;
+			}
+			write_trace(file);
+			return static_cast<bool>(file);
+		}
+
+#pragma endregion tracing
+
 		//prevent new tasks from being started by the thread pool
 		void exit()
 		{
 			exiting.test_and_set();
 		}
 
+		//stops taking jobs from outside the pool, jobs enqueued by other threads from now on are cancelled straight away
+		//if drain is set, waits up to the timeout for everything already queued to finish, along with any jobs that work enqueues in turn, then exits and joins the workers
+		//returns the number of accepted jobs left unfinished, must not be called from a worker thread
+		size_t shutdown(bool drain = true, std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+		{
+			assert(context.pool != this);
+			accepting.store(false, std::memory_order_release);
+			if (drain)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				while (unfinished_jobs.load(std::memory_order_acquire) != 0 && std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start) < timeout)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+			wait_exit();
+			return unfinished_jobs.load(std::memory_order_acquire);
+		}
+
 		//tells the thread pool to not start new jobs, and then block the calling thread until all worker threads are finished, indicating the pool can be safely destroyed, returns false if called from a worker thread and could not guarentee full wait cleanup
 		bool wait_exit()
 		{
 			exit();
+			std::scoped_lock lock(resize_lock);
 			for (auto& thread : child_threads)
 			{
 				if(thread.get_id() != std::this_thread::get_id() && thread.joinable())
@@ -212,6 +780,20 @@ namespace spool
 		}
 
 	private:
+		//filled in field by field, a partial designated initialiser trips -Wmissing-field-initializers for everyone including us
+		static pool_options make_options(unsigned int thread_count, unsigned int attachable_workers)
+		{
+			pool_options options;
+			options.thread_count = thread_count;
+			options.attachable_workers = attachable_workers;
+			return options;
+		}
+
+		enum class worker_state : uint8_t
+		{
+			inactive, running, retiring
+		};
+
 		struct worker
 		{
 			worker(int index)
@@ -220,47 +802,321 @@ namespace spool
 				worker_index(index)
 			{}
 
-			detail::WorkStealingQueue<std::shared_ptr<job>> work_queue;
+			~worker()
+			{
+				//let go of anything still queued, only ever destroyed once every thread is done with the pool
+				while (const auto leftover = work_queue.pop())
+				{
+					claim(leftover.value());
+				}
+			}
+
+			//the queue holds plain pointers so its slots stay lock free, a queued job keeps itself alive until whoever pops or steals it claims it back
+			void push_local(const std::shared_ptr<job>& queued)
+			{
+				queued->queued_self = queued;
+				work_queue.push(queued.get());
+			}
+
+			static std::shared_ptr<job> claim(job* queued)
+			{
+				return std::move(queued->queued_self);
+			}
+
+			detail::WorkStealingQueue<job*> work_queue;
 			std::shared_ptr<job> active_job;
 			size_t worker_index;
+			detail::worker_counters counters;
+			detail::worker_latency latency;
+			//where next_job found the active job
+			size_t job_origin = detail::origin_local;
+			std::unique_ptr<detail::trace_ring> trace;
+			size_t node = 0;
+			//cpus the worker's thread is pinned to, empty if unpinned
+			std::vector<unsigned int> cpus;
+			//workers to try stealing from, same node first
+			std::vector<size_t> steal_order;
+			std::atomic<worker_state> state = worker_state::inactive;
+			//jobs pinned to this worker by other threads, never stolen
+			rigtorp::mpmc::Queue<std::shared_ptr<job>> mailbox{ max_mailbox_jobs };
+			//jobs other workers pinned to us while the mailbox was full
+			detail::overflow_queue mailbox_overflow;
+			//jobs this worker pinned to itself, only ever touched by the worker's own thread
+			std::deque<std::shared_ptr<job>> private_jobs;
+			//worker groups this worker belongs to
+			std::vector<size_t> groups;
+			//jobs that couldn't run yet or couldn't be queued, retried between jobs, only ever touched by the worker's own thread
+			std::deque<std::shared_ptr<job>> held_jobs;
+			//a dependant released by the job we just finished, run next while its inputs are still in cache
+			std::shared_ptr<job> handoff;
+			//job-temporary memory, only ever used from the worker's own thread
+			scratch_arena scratch;
+			//the reclamation epoch this worker last saw between jobs, or max while it isn't running
+			std::atomic_uint64_t quiescent_epoch = UINT64_MAX;
+			//the arena this worker is taking jobs from, and how many it's taken so far
+			size_t arena_cursor = 0;
+			unsigned int arena_taken = 0;
+			bool arenas_first = false;
+
+			//work nobody else can pick up for us
+			bool has_private_work() const
+			{
+				return handoff != nullptr || !private_jobs.empty() || !mailbox.empty() || !mailbox_overflow.empty();
+			}
 
 			void run(thread_pool* pool)
             {
-                std::deque<std::shared_ptr<job>> held_jobs;
+                std::chrono::steady_clock::time_point idle_since;
+                bool idle = false;
                 thread_pool::context = { pool, worker_index };
-                while (!pool->exiting.test())
+                if (detail::pin_current_thread(cpus))
                 {
-                    active_job = pool->next_job(worker_index);
-                    if (active_job != nullptr)
+                    //now that we're on the right node, first-touch our queue's storage there
+                    work_queue.rehome();
+                }
+                //first touch our scratch memory from our own thread as well, it's kept between runs
+                scratch.reserve();
+                quiescent_epoch.store(pool->reclaim_epoch.load(), std::memory_order_seq_cst);
+                //only thread slots come and go, attached workers leave when their caller's pool exits
+                const bool elastic = pool->elastic && worker_index < pool->max_threads;
+                size_t since_grow_check = 0;
+                size_t since_reap_check = 0;
+                //a retiring worker still sees its pinned jobs through, since nobody else is allowed to run them
+                while (!pool->exiting.test() && (state.load(std::memory_order_relaxed) == worker_state::running || has_private_work() || !held_jobs.empty()))
+                {
+                    //between jobs we aren't reading anyone's queue, so any array retired before now is safe from us
+                    const uint64_t epoch = pool->reclaim_epoch.load(std::memory_order_seq_cst);
+                    if (epoch != quiescent_epoch.load(std::memory_order_relaxed))
                     {
-                        //we actually have a job, run it
-                        if (active_job->try_run())
-                        {
-                            //job completed succesfully, offer to delete then dump all our held jobs back into the queue
-                            active_job = nullptr;
+                        quiescent_epoch.store(epoch, std::memory_order_seq_cst);
+                    }
+                    if (work_queue.retired() != 0)
+                    {
+                        pool->reclaim_retired(*this);
+                    }
 
-                            while (!held_jobs.empty())
-                            {
-                                pool->workers[worker_index].work_queue.push(held_jobs.back());
-                                held_jobs.pop_back();
-                            }
-                        }
-                        else
+                    active_job = pool->next_job(worker_index);
+                    if (idle && active_job != nullptr)
+                    {
+                        if constexpr (detail::stats_enabled)
                         {
-                            //the job couldn't run, hold it
-                            held_jobs.push_back(active_job);
+                            counters.idle_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - idle_since).count());
                         }
+                        pool->idle_workers.fetch_sub(1, std::memory_order_relaxed);
+                        idle = false;
                     }
-                    else
+                    else if (!idle && active_job == nullptr)
                     {
-                        //no job offered, dump our held jobs back
-                        while (!held_jobs.empty())
+                        //only read the clock when going into or coming out of an idle stretch
+                        if (detail::stats_enabled || elastic)
+                        {
+                            idle_since = std::chrono::steady_clock::now();
+                        }
+                        pool->idle_workers.fetch_add(1, std::memory_order_relaxed);
+                        idle = true;
+                        if (pool->shrink_queues)
                         {
-                            pool->workers[worker_index].work_queue.push(held_jobs.back());
-                            held_jobs.pop_back();
+                            work_queue.shrink(max_assigned_jobs);
                         }
                     }
-                }
+                    else if (idle && elastic && held_jobs.empty() && std::chrono::steady_clock::now() - idle_since > pool->idle_timeout)
+                    {
+                        pool->try_retire(worker_index);
+                        continue;
+                    }
+                    if (active_job != nullptr)
+                    {
+                        //we actually have a job, run it
+                        arena* const owner = active_job->options.arena;
+                        const bool finished = run_attempt(pool, *active_job, job_origin);
+                        //whatever the job put in scratch memory is dead now, whether it ran or not
+                        scratch.reset();
+#ifdef SPOOL_HAS_IO_URING
+                        //a worker that never runs dry would never reap, leaving jobs waiting on reads that have long since landed
+                        if (++since_reap_check == reap_check_interval)
+                        {
+                            since_reap_check = 0;
+                            if (pool->io_in_flight.load(std::memory_order_relaxed) != 0)
+                            {
+                                pool->reap_reads();
+                            }
+                        }
+#endif
+                        if (job_origin == detail::origin_arena)
+                        {
+                            owner->release();
+                        }
+                        if (finished)
+                        {
+                            //job completed succesfully, release anything parked on it, offer to delete then dump all our held jobs back into the queue
+                            pool->resume_continuations(*this, *active_job);
+                            active_job = nullptr;
+                            if (owner != nullptr)
+                            {
+                                owner->finish();
+                            }
+                            pool->unfinished_jobs.fetch_sub(1, std::memory_order_release);
+                            counters.jobs_executed.add();
+                            requeue_held(pool);
+                            if (elastic && ++since_grow_check == grow_check_interval)
+                            {
+                                since_grow_check = 0;
+                                pool->maybe_grow(work_queue.size());
+                            }
+                        }
+                        else
+                        {
+                            std::shared_ptr<job> blocker = std::move(active_job->blocked_on);
+                            if (blocker != nullptr && blocker->pool == pool && blocker->add_continuation(active_job))
+                            {
+                                //parked until the prerequisite completes, rather than polling it
+                                counters.jobs_parked.add();
+                            }
+                            else
+                            {
+                                //the job couldn't run, hold it
+                                active_job->blocked_on = std::move(blocker);
+                                counters.jobs_held.add();
+                                held_jobs.push_back(active_job);
+                            }
+                        }
+                    }
+                    else
+                    {
+                        //no job offered, dump our held jobs back
+                        requeue_held(pool);
+                    }
+                }
+                if (idle)
+                {
+                    if constexpr (detail::stats_enabled)
+                    {
+                        counters.idle_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - idle_since).count());
+                    }
+                    pool->idle_workers.fetch_sub(1, std::memory_order_relaxed);
+                }
+                //we won't steal again until we next run
+                quiescent_epoch.store(UINT64_MAX, std::memory_order_seq_cst);
+                if (!pool->exiting.test())
+                {
+                    //we're retiring, hand everything we were holding back to the pool for the remaining workers
+                    requeue_held(pool);
+                    while (const auto leftover = work_queue.pop())
+                    {
+                        pool->unassigned_jobs.emplace(claim(leftover.value()));
+                    }
+                }
+                else
+                {
+                    //the pool's going away, nothing will run them
+                    held_jobs.clear();
+                }
+            }
+
+            //one attempt at a job, stamped for the latency histograms and traced while the pool is measuring, true if it's done
+            bool run_attempt(thread_pool* pool, job& attempted, size_t origin)
+            {
+                const bool tracing = pool->tracing.load(std::memory_order_acquire);
+                //only jobs enqueued while latency was being measured carry a timestamp
+                const bool timed = detail::latency_enabled && attempted.timing.enqueued != std::chrono::steady_clock::time_point{};
+                //one clock read serves the trace, the first attempt and the start, try_run copies it rather than reading the clock again
+                const auto begin = tracing || timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+                if constexpr (detail::latency_enabled)
+                {
+                    if (timed)
+                    {
+                        if (attempted.timing.first_attempt == std::chrono::steady_clock::time_point{})
+                        {
+                            attempted.timing.first_attempt = begin;
+                        }
+                        attempted.timing.attempt = begin;
+                    }
+                }
+                arena* const owner = attempted.options.arena;
+                if (owner != nullptr && owner->cancelled_since(attempted.arena_generation))
+                {
+                    attempted.cancel();
+                }
+                if (!attempted.try_run())
+                {
+                    return false;
+                }
+                const auto end = tracing || timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+                if constexpr (detail::latency_enabled)
+                {
+                    const auto& timing = attempted.timing;
+                    //jobs cancelled before they ever started have nothing to report
+                    if (timing.started != std::chrono::steady_clock::time_point{})
+                    {
+                        latency.queue_delay.record(timing.first_attempt - timing.enqueued);
+                        latency.blocked.record(timing.started - timing.first_attempt);
+                        latency.run_time.record(end - timing.started);
+                    }
+                }
+                if (tracing)
+                {
+                    trace->record({ attempted.options.name, detail::nanoseconds_between(pool->trace_start, begin), detail::nanoseconds_between(pool->trace_start, end), origin });
+                }
+                return true;
+            }
+
+            void requeue_held(thread_pool* pool)
+            {
+                if (held_jobs.empty())
+                {
+                    return;
+                }
+                for (size_t remaining = held_jobs.size(); remaining > 0; remaining--)
+                {
+                    std::shared_ptr<job> held = std::move(held_jobs.front());
+                    held_jobs.pop_front();
+                    if (held->options.worker != any_worker)
+                    {
+                        //only ever held by the worker it's pinned to
+                        private_jobs.push_back(std::move(held));
+                    }
+                    else if (held->options.group != no_group)
+                    {
+                        if (!pool->group_jobs[held->options.group].try_push(held))
+                        {
+                            //the group's mailbox is full, keep it here rather than wait, we're a member so that's allowed
+                            private_jobs.push_back(std::move(held));
+                        }
+                    }
+                    else if (held->options.arena != nullptr)
+                    {
+                        //back through the arena's queue so it still counts against the arena's concurrency
+                        if (!held->options.arena->jobs.try_push(held))
+                        {
+                            held_jobs.push_back(std::move(held));
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        push_local(held);
+                    }
+                    counters.held_requeued.add();
+                }
+            }
+
+            worker_stats stats() const
+            {
+                worker_stats snapshot;
+                snapshot.jobs_executed = counters.jobs_executed.get();
+                snapshot.jobs_held = counters.jobs_held.get();
+                snapshot.held_requeued = counters.held_requeued.get();
+                snapshot.unassigned_pops = counters.unassigned_pops.get();
+                snapshot.steal_attempts = counters.steal_attempts.get();
+                snapshot.steals = counters.steals.get();
+                snapshot.idle_time = std::chrono::nanoseconds(counters.idle_ns.get());
+                snapshot.jobs_parked = counters.jobs_parked.get();
+                snapshot.handoffs = counters.handoffs.get();
+                snapshot.jobs_inlined = counters.jobs_inlined.get();
+                snapshot.queue_depth = work_queue.size();
+                snapshot.queue_capacity = static_cast<size_t>(work_queue.capacity());
+                snapshot.retired_arrays = work_queue.retired();
+                return snapshot;
             }
 
 		};
@@ -272,58 +1128,875 @@ namespace spool
 
 		std::shared_ptr<job> next_job(size_t worker_index)
 		{
-			const std::optional<std::shared_ptr<job>> immediate_job = workers[worker_index].work_queue.pop();
+			worker& self = workers[worker_index];
+			std::shared_ptr<job> assigned_job = nullptr;
+
+			if (self.handoff != nullptr)
+			{
+				self.counters.handoffs.add();
+				self.job_origin = detail::origin_local;
+				return std::move(self.handoff);
+			}
+
+			//pinned jobs first, nobody else can take them so they shouldn't wait behind stealable work
+			if (!self.private_jobs.empty())
+			{
+				assigned_job = std::move(self.private_jobs.front());
+				self.private_jobs.pop_front();
+				self.job_origin = detail::origin_mailbox;
+				return assigned_job;
+			}
+			if (self.mailbox.try_pop(assigned_job) || self.mailbox_overflow.try_pop(assigned_job))
+			{
+				self.job_origin = detail::origin_mailbox;
+				return assigned_job;
+			}
+
+			const std::optional<job*> immediate_job = self.work_queue.pop();
 			if (immediate_job.has_value())
 			{
-				return immediate_job.value();
+				self.job_origin = detail::origin_local;
+				return worker::claim(immediate_job.value());
 			}
 
-			//no job on own queue, try to pull from unassigned queue
-			std::shared_ptr<job> assigned_job = nullptr;
-			if (unassigned_jobs.try_pop(assigned_job))
+			for (const size_t group : self.groups)
+			{
+				if (group_jobs[group].try_pop(assigned_job) || group_overflow[group].try_pop(assigned_job))
+				{
+					self.job_origin = detail::origin_group;
+					return assigned_job;
+				}
+			}
+
+			//arenas and the pool's own queues take turns, so neither can starve the other
+			self.arenas_first = !self.arenas_first;
+			if (self.arenas_first && next_arena_job(self, assigned_job))
+			{
+				return assigned_job;
+			}
+
+			//no job on own queue, try jobs aimed at our node, then the unassigned queue
+			if (node_jobs[workers[worker_index].node].try_pop(assigned_job) || unassigned_jobs.try_pop(assigned_job))
 			{
 				//job poppped off unassigned queue, use that
+				workers[worker_index].counters.unassigned_pops.add();
+				workers[worker_index].job_origin = detail::origin_unassigned;
+				return assigned_job;
+			}
+
+			if (!self.arenas_first && next_arena_job(self, assigned_job))
+			{
 				return assigned_job;
 			}
 
-			//try to steal from other queues, going "right"
-			size_t steal_index = worker_index;
-			do
+			//try to steal from other queues, nearest first
+			for (const size_t steal_index : workers[worker_index].steal_order)
             {
-				steal_index++;
-				//if we've wrapped around, reset back
-				if (steal_index >= workers.size()) steal_index = 0;
-				std::optional<std::shared_ptr<job>> stolen_job = workers[steal_index].work_queue.steal();
-				if (stolen_job.has_value()) return stolen_job.value();
+				if (workers[steal_index].state.load(std::memory_order_acquire) == worker_state::inactive)
+				{
+					//nobody's there, and the last one out emptied the queue
+					continue;
+				}
+				workers[worker_index].counters.steal_attempts.add();
+				const std::optional<job*> stolen_job = workers[steal_index].work_queue.steal();
+				if (stolen_job.has_value())
+				{
+					workers[worker_index].counters.steals.add();
+					workers[worker_index].job_origin = steal_index;
+					return worker::claim(stolen_job.value());
+				}
 			}
-			while(steal_index != worker_index);
+#ifdef SPOOL_HAS_IO_URING
+			if (io_in_flight.load(std::memory_order_relaxed) != 0)
+			{
+				//nothing else to do, see if any reads have landed, the jobs waiting on them get picked up next time round
+				reap_reads();
+			}
+#endif
 			return nullptr;
 		}
 
+#ifdef SPOOL_HAS_FILE_IO
+		void start_read(int fd, uint64_t offset, std::span<std::byte> buffer, std::shared_ptr<input_data<file_read>> destination)
+		{
+#ifdef SPOOL_HAS_IO_URING
+			std::call_once(io_setup, [this]() { io = std::make_unique<detail::io_ring>(detail::io_ring_entries); });
+			if (io->available())
+			{
+				auto read = std::make_unique<detail::pending_read>(destination, buffer);
+				io_in_flight.fetch_add(1, std::memory_order_acq_rel);
+				if (io->submit_read(fd, offset, read))
+				{
+					return;
+				}
+				io_in_flight.fetch_sub(1, std::memory_order_acq_rel);
+			}
+#endif
+			//no ring, or it's full, so read on a worker instead, as a blocking job so a stand-in can cover for it
+			enqueue_blocking_job([=]() { destination->submit(detail::read_at(fd, offset, buffer)); });
+		}
+#endif
+
+#ifdef SPOOL_HAS_IO_URING
+		void reap_reads()
+		{
+			io_in_flight.fetch_sub(io->reap(), std::memory_order_acq_rel);
+		}
+#endif
+
+		template<bool any, typename R, typename P, typename F>
+		auto search(R& range, const P& pred, F&& work)
+		{
+			using T = std::conditional_t<any, bool, size_t>;
+			const auto first = std::ranges::begin(range);
+			const size_t n = std::ranges::size(range);
+			const auto bounds = detail::chunk_bounds(n, workers.size() * detail::search_chunks_per_worker);
+			const auto state = std::make_shared<detail::search_state>(n, bounds.size());
+			//the chunks don't hold up the data job as prerequisites, cancelling them would cancel it too, it waits on the result instead
+			data_job<T> result = enqueue_data_job<T>([state, work = std::forward<F>(work)](auto& found)
+				{
+					if (state->error)
+					{
+						std::rethrow_exception(state->error);
+					}
+					work(found);
+				});
+			if (bounds.empty())
+			{
+				result.data->submit(T(0));
+				return result;
+			}
+
+			std::vector<std::shared_ptr<job>> chunks;
+			for (size_t c = 0; c < bounds.size(); c++)
+			{
+				chunks.emplace_back(new job([=, data = result.data, begin = bounds[c].first, end = bounds[c].first + bounds[c].second]()
+					{
+						if (state->claimed[c].test_and_set())
+						{
+							//a match came before us after we were queued, it's already accounted for us
+							return;
+						}
+						try
+						{
+							for (size_t at = begin; at < end && !state->template stopped<any>(at); at += detail::search_grain)
+							{
+								const size_t grain_end = std::min(at + detail::search_grain, end);
+								const size_t found = static_cast<size_t>(std::find_if(first + at, first + grain_end, pred) - first);
+								if (found != grain_end)
+								{
+									if (state->offer(found))
+									{
+										cancel_search_chunks<any>(*state, *data, any ? 0 : c + 1);
+									}
+									break;
+								}
+							}
+						}
+						catch (...)
+						{
+							if (!state->failed.test_and_set())
+							{
+								state->error = std::current_exception();
+							}
+							cancel_search_chunks<any>(*state, *data, 0);
+						}
+						finish_search_chunk<any>(*state, *data);
+					}));
+				state->chunks[c] = chunks.back();
+			}
+			//only queued once every chunk is known, so a match can always find the ones it needs to cancel
+			for (const auto& chunk : chunks)
+			{
+				enqueue_job(chunk);
+			}
+			return result;
+		}
+
+		//cancels every chunk from the given one on that hasn't claimed itself by starting yet
+		template<bool any, typename T>
+		static void cancel_search_chunks(detail::search_state& state, input_data<T>& result, size_t from)
+		{
+			for (size_t c = from; c < state.chunks.size(); c++)
+			{
+				if (!state.claimed[c].test_and_set())
+				{
+					if (const auto chunk = state.chunks[c].lock())
+					{
+						chunk->cancel();
+					}
+					finish_search_chunk<any>(state, result);
+				}
+			}
+		}
+
+		template<bool any, typename T>
+		static void finish_search_chunk(detail::search_state& state, input_data<T>& result)
+		{
+			if (state.finish_chunk())
+			{
+				const size_t found = state.lowest.load(std::memory_order_acquire);
+				result.submit(any ? T(found != state.size) : T(found));
+			}
+		}
+
+		template<bool stable, typename R, typename C>
+		std::shared_ptr<job> merge_sort(R& range, const C& comp)
+		{
+			using T = range_underlying<R>;
+			const auto first = std::ranges::begin(range);
+			const size_t n = std::ranges::size(range);
+			const auto sort_serial = [comp](auto begin, auto end)
+			{
+				if constexpr (stable)
+				{
+					std::stable_sort(begin, end, comp);
+				}
+				else
+				{
+					std::sort(begin, end, comp);
+				}
+			};
+			//a power of two number of pieces, a couple per worker unless that makes them too small to bother with
+			size_t pieces = 1;
+			while (pieces < workers.size() * 2 && n / (pieces * 2) >= detail::serial_sort_cutoff)
+			{
+				pieces *= 2;
+			}
+			if constexpr (std::default_initializable<T>)
+			{
+				if (pieces > 1)
+				{
+					return merge_pieces(first, n, pieces, comp, sort_serial);
+				}
+			}
+			//nothing to merge, so no buffer either
+			return enqueue_job([=]() { sort_serial(first, first + n); });
+		}
+
+		//the parallel half of merge_sort, pieces is a power of two above one
+		template<typename I, typename C, typename S>
+		std::shared_ptr<job> merge_pieces(I first, size_t n, size_t pieces, const C& comp, const S& sort_serial)
+		{
+			using T = std::iter_value_t<I>;
+			std::vector<size_t> bounds(pieces + 1);
+			for (size_t i = 0; i <= pieces; i++)
+			{
+				bounds[i] = n * i / pieces;
+			}
+			const std::shared_ptr<T[]> buffer = std::make_unique_for_overwrite<T[]>(n);
+			std::vector<std::vector<std::shared_ptr<job>>> runs(pieces);
+			for (size_t i = 0; i < pieces; i++)
+			{
+				runs[i].push_back(enqueue_job([=, begin = bounds[i], end = bounds[i + 1]]() { sort_serial(first + begin, first + end); }));
+			}
+
+			//each level merges pairs of runs from one side to the other, every merge split along its merge path so big merges share the work too
+			bool in_buffer = false;
+			for (size_t width = 1; width < pieces; width *= 2)
+			{
+				std::vector<std::vector<std::shared_ptr<job>>> merged(runs.size() / 2);
+				for (size_t r = 0; r < merged.size(); r++)
+				{
+					const size_t low = bounds[r * 2 * width];
+					const size_t mid = bounds[r * 2 * width + width];
+					const size_t high = bounds[(r + 1) * 2 * width];
+					const size_t parts = std::clamp<size_t>((high - low) / detail::serial_sort_cutoff, 1, workers.size());
+					std::vector<std::shared_ptr<job>> inputs = std::move(runs[r * 2]);
+					inputs.insert(inputs.end(), runs[r * 2 + 1].begin(), runs[r * 2 + 1].end());
+					//the split points are found before any part starts moving elements out from under the search
+					const auto splits = std::make_shared<std::vector<size_t>>(parts + 1);
+					const auto split = enqueue_job([=]()
+						{
+							const auto find_splits = [&](auto source)
+							{
+								for (size_t p = 0; p <= parts; p++)
+								{
+									(*splits)[p] = detail::merge_path_split(source + low, mid - low, source + mid, high - mid, (high - low) * p / parts, comp);
+								}
+							};
+							if (in_buffer) find_splits(buffer.get());
+							else find_splits(first);
+						}, inputs);
+					for (size_t p = 0; p < parts; p++)
+					{
+						merged[r].push_back(enqueue_job([=]()
+							{
+								const size_t k_begin = (high - low) * p / parts;
+								const size_t k_end = (high - low) * (p + 1) / parts;
+								const size_t a_begin = (*splits)[p];
+								const size_t a_end = (*splits)[p + 1];
+								const auto merge_part = [&](auto source, auto destination)
+								{
+									std::merge(std::make_move_iterator(source + low + a_begin), std::make_move_iterator(source + low + a_end),
+										std::make_move_iterator(source + mid + (k_begin - a_begin)), std::make_move_iterator(source + mid + (k_end - a_end)),
+										destination + low + k_begin, comp);
+								};
+								if (in_buffer) merge_part(buffer.get(), first);
+								else merge_part(first, buffer.get());
+							}, split));
+					}
+				}
+				runs = std::move(merged);
+				in_buffer = !in_buffer;
+			}
+
+			std::vector<std::shared_ptr<job>> last = std::move(runs.front());
+			if (in_buffer)
+			{
+				//an odd number of levels left it all in the buffer, move it home
+				const size_t parts = std::clamp<size_t>(n / detail::serial_sort_cutoff, 1, workers.size());
+				std::vector<std::shared_ptr<job>> copies;
+				for (size_t p = 0; p < parts; p++)
+				{
+					copies.push_back(enqueue_job([=, begin = n * p / parts, end = n * (p + 1) / parts]()
+						{
+							std::move(buffer.get() + begin, buffer.get() + end, first + begin);
+						}, last));
+				}
+				last = std::move(copies);
+			}
+			//holds the buffer until the very end
+			return enqueue_job([buffer]() {}, last);
+		}
+
+		//releases the dependants parked on a job a worker just finished, the first one it may run is handed straight to it
+		void resume_continuations(worker& self, job& completed)
+		{
+			job* parked = completed.continuations.exchange(job::continuations_closed(), std::memory_order_acq_rel);
+			if (parked == job::continuations_closed())
+			{
+				return;
+			}
+			//parked last in first out, flip them so the first to park is the first to go
+			job* ordered = nullptr;
+			while (parked != nullptr)
+			{
+				job* next = parked->next_continuation;
+				parked->next_continuation = ordered;
+				ordered = parked;
+				parked = next;
+			}
+			const bool succeeded = completed.state.load(std::memory_order_acquire) == job::run_state::finished;
+			while (ordered != nullptr)
+			{
+				job* next = ordered->next_continuation;
+				std::shared_ptr<job> resumed = std::move(ordered->queued_self);
+				if (!succeeded)
+				{
+					//give it back the prerequisite so it sees the failure or cancellation for itself
+					resumed->prerequisites.push(completed.shared_from_this());
+				}
+				const job_options& options = resumed->options;
+				const bool unrestricted = options.arena == nullptr && options.group == no_group && (options.worker == any_worker || options.worker == self.worker_index);
+				if (self.handoff == nullptr && unrestricted)
+				{
+					self.handoff = std::move(resumed);
+				}
+				else
+				{
+					route_job(resumed);
+				}
+				ordered = next;
+			}
+		}
+
+		//frees the arrays a worker's queue has outgrown once no other worker can still be stealing from them
+		void reclaim_retired(worker& self)
+		{
+			//move everyone on past our newest retirement, so that their next trip round the loop counts
+			uint64_t current = reclaim_epoch.load(std::memory_order_seq_cst);
+			if (self.work_queue.newest_retired_epoch() >= current)
+			{
+				reclaim_epoch.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+			}
+			uint64_t oldest = UINT64_MAX;
+			for (const auto& w : workers)
+			{
+				if (&w != &self)
+				{
+					oldest = std::min(oldest, w.quiescent_epoch.load(std::memory_order_seq_cst));
+				}
+			}
+			self.work_queue.reclaim(oldest);
+		}
+
+		//weighted round robin over the arenas, a worker takes up to an arena's weight in jobs from it before moving to the next
+		bool next_arena_job(worker& self, std::shared_ptr<job>& assigned_job)
+		{
+			const size_t count = arena_count.load(std::memory_order_acquire);
+			for (size_t tried = 0; tried < count; tried++)
+			{
+				arena& candidate = *arenas[self.arena_cursor % count];
+				if (!candidate.jobs.empty() && candidate.try_acquire())
+				{
+					if (candidate.jobs.try_pop(assigned_job))
+					{
+						if (++self.arena_taken >= candidate.options.weight)
+						{
+							self.arena_cursor++;
+							self.arena_taken = 0;
+						}
+						self.job_origin = detail::origin_arena;
+						return true;
+					}
+					candidate.release();
+				}
+				self.arena_cursor++;
+				self.arena_taken = 0;
+			}
+			return false;
+		}
+
+		ptrdiff_t arena_backlog() const
+		{
+			ptrdiff_t backlog = 0;
+			const size_t count = arena_count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; i++)
+			{
+				backlog += std::max<ptrdiff_t>(0, arenas[i]->jobs.size());
+			}
+			return backlog;
+		}
+
+		//each worker steals from workers on its own node first, then everyone else, in both cases going "right" from itself
+		void build_steal_orders()
+		{
+			for (auto& w : workers)
+			{
+				w.steal_order.clear();
+				for (const bool same_node : { true, false })
+				{
+					for (size_t offset = 1; offset < workers.size(); offset++)
+					{
+						const size_t victim = (w.worker_index + offset) % workers.size();
+						if ((workers[victim].node == w.node) == same_node)
+						{
+							w.steal_order.push_back(victim);
+						}
+					}
+				}
+			}
+		}
+
 		void enqueue_job(const std::shared_ptr<job>& new_job)
 		{
+			if (context.pool != this && !accepting.load(std::memory_order_acquire))
+			{
+				//shutting down, only the pool's own jobs may still add work
+				new_job->cancel();
+				return;
+			}
+			unfinished_jobs.fetch_add(1, std::memory_order_relaxed);
+			if constexpr (detail::latency_enabled)
+			{
+				if (measuring_latency.load(std::memory_order_relaxed))
+				{
+					new_job->timing.enqueued = std::chrono::steady_clock::now();
+				}
+			}
+			if (context.pool == this && workers[context.runner_index].active_job != nullptr)
+			{
+				//children stay in their parent's arena and share its fate
+				const auto& parent = workers[context.runner_index].active_job;
+				if (new_job->options.arena == nullptr && new_job->options.worker == any_worker && new_job->options.group == no_group)
+				{
+					new_job->options.arena = parent->options.arena;
+				}
+				if (!new_job->options.cancellation.can_be_cancelled())
+				{
+					new_job->options.cancellation = parent->options.cancellation;
+				}
+			}
+			new_job->pool = this;
+			if (new_job->options.may_inline && try_inline(new_job))
+			{
+				return;
+			}
+			if (new_job->options.arena != nullptr)
+			{
+				new_job->arena_generation = new_job->options.arena->generation.load(std::memory_order_acquire);
+				new_job->options.arena->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			route_job(new_job, true);
+		}
+
+		//runs a tiny job straight away on the enqueuing worker, when queueing it would only add to a backlog nobody is free to steal from
+		bool try_inline(const std::shared_ptr<job>& new_job)
+		{
+			const job_options& options = new_job->options;
+			if (context.pool != this || options.worker != any_worker || options.group != no_group || options.arena != nullptr || options.node != any_node)
+			{
+				return false;
+			}
+			worker& self = workers[context.runner_index];
+			if (self.work_queue.size() < inline_threshold || idle_workers.load(std::memory_order_relaxed) != 0 || !new_job->prerequisites.empty())
+			{
+				return false;
+			}
+			return run_inline(self, new_job);
+		}
+
+		//runs a job with no prerequisites on the spot, in place of queueing it, false if it asked to be retried
+		bool run_inline(worker& self, const std::shared_ptr<job>& new_job)
+		{
+			//the inlined job is the active one while it runs, so its own children see it as their parent
+			//it shares its parent's scratch memory, which is only reset once the parent is done
+			std::shared_ptr<job> parent = std::exchange(self.active_job, new_job);
+			//timed and traced like any other job, so the tiny ones this is for don't vanish from latency() and write_trace()
+			const bool finished = self.run_attempt(this, *new_job, detail::origin_inlined);
+			self.active_job = std::move(parent);
+			if (!finished)
+			{
+				//it asked to be retried, so it has to be queued after all
+				return false;
+			}
+			resume_continuations(self, *new_job);
+			unfinished_jobs.fetch_sub(1, std::memory_order_release);
+			self.counters.jobs_inlined.add();
+			return true;
+		}
+
+		//puts a job in the queue its options call for, without counting it as new
+		//forked when the worker's running job is enqueuing it, rather than it being resumed after that job finished
+		void route_job(const std::shared_ptr<job>& new_job, bool forked = false)
+		{
+			const job_options& options = new_job->options;
+			if (options.worker != any_worker)
+			{
+				assert(options.worker < workers.size());
+				if (context.pool == this && context.runner_index == options.worker)
+				{
+					workers[options.worker].private_jobs.push_back(new_job);
+				}
+				else
+				{
+					worker& target = workers[options.worker];
+					if (context.pool != this)
+					{
+						target.mailbox.emplace(new_job);
+					}
+					else if (!target.mailbox.try_push(new_job))
+					{
+						//the target may be waiting on room in our own mailbox, so don't wait on its
+						target.mailbox_overflow.push(new_job);
+					}
+					wake_worker(options.worker);
+				}
+				return;
+			}
+			if (options.group != no_group)
+			{
+				assert(options.group < worker_groups.size());
+				if (context.pool != this)
+				{
+					group_jobs[options.group].emplace(new_job);
+				}
+				else if (!group_jobs[options.group].try_push(new_job))
+				{
+					//we may be the only one who could make room, keep it if we're a member, as requeue_held does
+					worker& self = workers[context.runner_index];
+					if (std::ranges::find(self.groups, options.group) != self.groups.end())
+					{
+						self.private_jobs.push_back(new_job);
+					}
+					else
+					{
+						group_overflow[options.group].push(new_job);
+					}
+				}
+				if (elastic)
+				{
+					const auto& members = worker_groups[options.group].members;
+					if (!members.empty() && std::ranges::none_of(members, [&](size_t m) {return workers[m].state.load() != worker_state::inactive; }))
+					{
+						wake_worker(members.front());
+					}
+				}
+				return;
+			}
+			if (options.arena != nullptr)
+			{
+				if (context.pool != this)
+				{
+					options.arena->jobs.emplace(new_job);
+				}
+				else if (!options.arena->jobs.try_push(new_job))
+				{
+					//we may be holding the arena's only slot, so don't wait for room
+					worker& self = workers[context.runner_index];
+					arena* const owner = options.arena;
+					//only a job still running from the arena's queue holds a slot, continuations are routed after it gave its slot back
+					const bool holds_slot = forked && self.job_origin == detail::origin_arena && self.active_job != nullptr && self.active_job->options.arena == owner;
+					if (holds_slot && !owner->cancelled_since(new_job->arena_generation) && new_job->prerequisites.empty() && run_inline(self, new_job))
+					{
+						//ran in the slot our own job already holds, so the arena's concurrency is unchanged
+						owner->finish();
+					}
+					else
+					{
+						//hold it, requeue_held pushes it once there's room
+						self.held_jobs.push_back(new_job);
+					}
+				}
+				if (elastic && context.pool != this)
+				{
+					maybe_grow(0);
+				}
+				return;
+			}
+			size_t node = options.node;
+			if (node != any_node && node_count > 1)
+			{
+				node %= node_count;
+				if (context.pool != this || workers[context.runner_index].node != node)
+				{
+					node_jobs[node].emplace(new_job);
+					return;
+				}
+			}
 			if (context.pool == this)
 			{
-				workers[context.runner_index].work_queue.push(new_job);
+				workers[context.runner_index].push_local(new_job);
 			}
 			else
 			{
 				unassigned_jobs.emplace(new_job);
+				if (elastic)
+				{
+					maybe_grow(0);
+				}
 			}
 		}
 
 		static void run_worker(thread_pool* pool, size_t worker_index)
 		{
-			pool->workers[worker_index].run(pool);
+			worker& w = pool->workers[worker_index];
+			while (true)
+			{
+				w.run(pool);
+				w.state.store(worker_state::inactive);
+				//a job may have been pinned to us just as we were leaving, if so and nobody has restarted the slot, carry on ourselves
+				//stand-ins are only ever started and stopped by their blocking_region, so they just leave
+				if (pool->exiting.test() || (w.mailbox.empty() && w.mailbox_overflow.empty()) || worker_index >= pool->max_threads)
+				{
+					return;
+				}
+				worker_state expected = worker_state::inactive;
+				if (!w.state.compare_exchange_strong(expected, worker_state::running))
+				{
+					return;
+				}
+				pool->active_threads++;
+			}
+		}
+
+		//must hold resize_lock, returns false if the slot was already claimed
+		bool start_thread(size_t worker_index)
+		{
+			worker_state expected = worker_state::inactive;
+			if (!workers[worker_index].state.compare_exchange_strong(expected, worker_state::running))
+			{
+				return false;
+			}
+			if (child_threads[worker_index].joinable())
+			{
+				//the slot's previous thread has retired, it's at most a moment away from finishing
+				child_threads[worker_index].join();
+			}
+			if (worker_index < max_threads)
+			{
+				active_threads++;
+			}
+			child_threads[worker_index] = std::thread(run_worker, this, worker_index);
+			return true;
+		}
+
+		//starts a stand-in for a worker about to block, returns its slot, or SIZE_MAX if every slot is taken
+		size_t begin_compensation()
+		{
+			if (compensation_threads == 0)
+			{
+				return SIZE_MAX;
+			}
+			//wait_exit holds the lock while joining, so don't block on it from a worker
+			std::unique_lock lock(resize_lock, std::try_to_lock);
+			while (!lock.owns_lock())
+			{
+				if (exiting.test())
+				{
+					return SIZE_MAX;
+				}
+				std::this_thread::yield();
+				lock.try_lock();
+			}
+			if (exiting.test())
+			{
+				return SIZE_MAX;
+			}
+			for (size_t i = max_threads; i < max_threads + compensation_threads; i++)
+			{
+				if (start_thread(i))
+				{
+					return i;
+				}
+			}
+			return SIZE_MAX;
+		}
+
+		//the blocked worker is back, its stand-in finishes its current job and leaves
+		void end_compensation(size_t slot)
+		{
+			if (slot == SIZE_MAX)
+			{
+				return;
+			}
+			worker_state expected = worker_state::running;
+			workers[slot].state.compare_exchange_strong(expected, worker_state::retiring);
+		}
+
+		//restarts a retired thread slot so that a job pinned to it can run
+		void wake_worker(size_t worker_index)
+		{
+			if (!elastic || worker_index >= max_threads || workers[worker_index].state.load() != worker_state::inactive)
+			{
+				return;
+			}
+			//wait_exit holds the lock while joining, so don't block on it from a worker
+			std::unique_lock lock(resize_lock, std::try_to_lock);
+			while (!lock.owns_lock())
+			{
+				if (exiting.test())
+				{
+					return;
+				}
+				std::this_thread::yield();
+				lock.try_lock();
+			}
+			if (!exiting.test() && workers[worker_index].state.load() == worker_state::inactive)
+			{
+				start_thread(worker_index);
+			}
+		}
+
+		//called by workers every so often, adds a thread if there's a backlog and nobody free to take it
+		void maybe_grow(size_t local_backlog)
+		{
+			if (idle_workers.load(std::memory_order_relaxed) != 0 || active_threads.load(std::memory_order_relaxed) >= max_threads)
+			{
+				return;
+			}
+			const auto backlog = local_backlog + std::max<ptrdiff_t>(0, unassigned_jobs.size()) + arena_backlog();
+			if (backlog < grow_backlog)
+			{
+				return;
+			}
+			//never make a worker wait on a resize in progress, someone else is already handling it
+			std::unique_lock lock(resize_lock, std::try_to_lock);
+			if (!lock.owns_lock() || exiting.test())
+			{
+				return;
+			}
+			for (size_t i = 0; i < max_threads; i++)
+			{
+				if (workers[i].state.load(std::memory_order_acquire) == worker_state::inactive && start_thread(i))
+				{
+					return;
+				}
+			}
+		}
+
+		//retires an idle worker thread, unless that would take the pool below its minimum
+		void try_retire(size_t worker_index)
+		{
+			//claim the retirement first, so a concurrent resize can't retire us a second time
+			worker_state expected = worker_state::running;
+			if (!workers[worker_index].state.compare_exchange_strong(expected, worker_state::retiring))
+			{
+				return;
+			}
+			unsigned int active = active_threads.load();
+			while (true)
+			{
+				if (active <= min_threads)
+				{
+					workers[worker_index].state.store(worker_state::running);
+					return;
+				}
+				if (active_threads.compare_exchange_weak(active, active - 1))
+				{
+					return;
+				}
+			}
 		}
 		
 		rigtorp::mpmc::Queue<std::shared_ptr<job>> unassigned_jobs;
+		//jobs submitted for a particular node, one queue per node
+		std::deque<rigtorp::mpmc::Queue<std::shared_ptr<job>>> node_jobs;
+		size_t node_count = 1;
+		std::vector<worker_group_options> worker_groups;
+		//jobs restricted to a worker group, one queue per group, only popped by members
+		std::deque<rigtorp::mpmc::Queue<std::shared_ptr<job>>> group_jobs;
+		//group jobs from non-members that found the group's queue full
+		std::deque<detail::overflow_queue> group_overflow;
+		std::array<std::unique_ptr<arena>, detail::max_arenas> arenas;
+		std::atomic_size_t arena_count = 0;
+		std::mutex arena_lock;
 		std::atomic_int unattached_workers;
 		std::deque<worker> workers;
 		std::deque<std::thread> child_threads;
 		std::atomic_flag exiting;
+		//advanced whenever a worker has queue arrays to free, see reclaim_retired
+		std::atomic_uint64_t reclaim_epoch = 1;
+		bool shrink_queues = true;
+		std::atomic_bool accepting = true;
+		//jobs enqueued that haven't yet finished, failed or been cancelled
+		std::atomic_size_t unfinished_jobs = 0;
+		//only set up the first time a file is read, most pools never need it
+#ifdef SPOOL_HAS_IO_URING
+		std::once_flag io_setup;
+		std::unique_ptr<detail::io_ring> io;
+#endif
+		std::atomic_size_t io_in_flight = 0;
+
+		const unsigned int min_threads;
+		const unsigned int max_threads;
+		//stand-in slots sit after the thread slots and before the attachable ones
+		const unsigned int compensation_threads;
+		const std::chrono::milliseconds idle_timeout;
+		const size_t grow_backlog;
+		const size_t inline_threshold;
+		bool elastic = false;
+		std::atomic_uint active_threads = 0;
+		std::atomic_uint idle_workers = 0;
+		//serialises starting, retiring and joining threads, never taken on the job path
+		std::mutex resize_lock;
+		static constexpr size_t grow_check_interval = 32;
+		//how many jobs a worker runs between checking for completed reads when it isn't running dry
+		static constexpr size_t reap_check_interval = 32;
+		std::atomic_bool tracing = false;
+		std::atomic_bool measuring_latency = false;
+		bool trace_rings_ready = false;
+		std::chrono::steady_clock::time_point trace_start;
 
 		inline static thread_local detail::thread_context context = { nullptr, SIZE_MAX };
 	};
 
+	inline blocking_region::blocking_region()
+		:pool(thread_pool::context.pool), slot(SIZE_MAX)
+	{
+		//outside of a pool there's nobody to stand in for
+		if (pool != nullptr)
+		{
+			slot = pool->begin_compensation();
+		}
+	}
+
+	inline blocking_region::~blocking_region()
+	{
+		if (pool != nullptr)
+		{
+			pool->end_compensation(slot);
+		}
+	}
 }
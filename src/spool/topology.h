@@ -0,0 +1,223 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <cstddef>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace spool::detail
+{
+	//parses the kernel's cpu list format, e.g. "0-3,8,10-11"
+	inline std::vector<unsigned int> parse_cpu_list(const std::string& list)
+	{
+		std::vector<unsigned int> cpus;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (item.empty() || item == "\n") continue;
+			const auto dash = item.find('-');
+			try
+			{
+				const unsigned int first = static_cast<unsigned int>(std::stoul(item.substr(0, dash)));
+				const unsigned int last = dash == std::string::npos ? first : static_cast<unsigned int>(std::stoul(item.substr(dash + 1)));
+				for (unsigned int cpu = first; cpu <= last; cpu++)
+				{
+					cpus.push_back(cpu);
+				}
+			}
+			catch (...)
+			{
+				//malformed entry, skip it rather than failing the whole list
+			}
+		}
+		return cpus;
+	}
+
+	inline std::string read_first_line(const std::string& path)
+	{
+		std::ifstream file(path);
+		std::string line;
+		std::getline(file, line);
+		return line;
+	}
+
+	//which cpus belong to which numa node, each node's cpus ordered so that every physical core comes before any of its hyperthread siblings
+	class cpu_topology final
+	{
+	public:
+		static const cpu_topology& get()
+		{
+			static const cpu_topology topology;
+			return topology;
+		}
+
+		size_t node_count() const
+		{
+			return node_cpus.size();
+		}
+
+		const std::vector<unsigned int>& cpus(size_t node) const
+		{
+			return node_cpus[node];
+		}
+
+		size_t node_of(unsigned int cpu) const
+		{
+			for (size_t node = 0; node < node_cpus.size(); node++)
+			{
+				if (std::ranges::find(node_cpus[node], cpu) != node_cpus[node].end())
+				{
+					return node;
+				}
+			}
+			return 0;
+		}
+
+	private:
+		cpu_topology()
+		{
+#if defined(__linux__)
+			cpu_set_t allowed;
+			CPU_ZERO(&allowed);
+			const bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+			const auto usable = [&](unsigned int cpu)
+			{
+				return !have_allowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+			};
+
+			for (const unsigned int node : parse_cpu_list(read_first_line("/sys/devices/system/node/online")))
+			{
+				std::vector<unsigned int> cpus;
+				for (const unsigned int cpu : parse_cpu_list(read_first_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+				{
+					if (usable(cpu)) cpus.push_back(cpu);
+				}
+				if (!cpus.empty()) node_cpus.push_back(order_by_core(cpus));
+			}
+
+			if (node_cpus.empty())
+			{
+				std::vector<unsigned int> cpus;
+				for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+				{
+					if (have_allowed && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+				}
+				if (!cpus.empty()) node_cpus.push_back(order_by_core(cpus));
+			}
+#endif
+			if (node_cpus.empty())
+			{
+				//no topology information, assume one node with every cpu
+				std::vector<unsigned int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+				for (unsigned int cpu = 0; cpu < cpus.size(); cpu++)
+				{
+					cpus[cpu] = cpu;
+				}
+				node_cpus.push_back(std::move(cpus));
+			}
+		}
+
+		static std::vector<unsigned int> order_by_core(std::vector<unsigned int> cpus)
+		{
+#if defined(__linux__)
+			//rank each cpu by its position amongst its hyperthread siblings, so the first thread of every core sorts first
+			std::vector<std::pair<size_t, unsigned int>> ranked;
+			for (const unsigned int cpu : cpus)
+			{
+				const auto siblings = parse_cpu_list(read_first_line("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+				const auto position = std::ranges::find(siblings, cpu);
+				ranked.emplace_back(position == siblings.end() ? 0 : static_cast<size_t>(position - siblings.begin()), cpu);
+			}
+			std::ranges::sort(ranked);
+			for (size_t i = 0; i < ranked.size(); i++)
+			{
+				cpus[i] = ranked[i].second;
+			}
+#endif
+			return cpus;
+		}
+
+		std::vector<std::vector<unsigned int>> node_cpus;
+	};
+
+	//the number of cpus' worth of time the process's cgroup allows it, or 0 if it isn't limited or we can't tell
+	inline double cpu_quota()
+	{
+#if defined(__linux__)
+		//cgroup v2, "max 100000" or "<quota> <period>"
+		{
+			std::ifstream file("/sys/fs/cgroup/cpu.max");
+			std::string quota;
+			double period = 0;
+			if (file >> quota >> period)
+			{
+				if (quota == "max" || period <= 0) return 0;
+				try
+				{
+					return std::stod(quota) / period;
+				}
+				catch (...)
+				{
+					return 0;
+				}
+			}
+		}
+		//cgroup v1, a quota of -1 means unlimited
+		for (const std::string dir : { "/sys/fs/cgroup/cpu/", "/sys/fs/cgroup/cpu,cpuacct/" })
+		{
+			std::ifstream quota_file(dir + "cpu.cfs_quota_us");
+			std::ifstream period_file(dir + "cpu.cfs_period_us");
+			double quota = 0;
+			double period = 0;
+			if (quota_file >> quota && period_file >> period)
+			{
+				return (quota <= 0 || period <= 0) ? 0 : quota / period;
+			}
+		}
+#endif
+		return 0;
+	}
+
+	//restricts the calling thread to the given cpus, returns false if that isn't supported or the os refused
+	inline bool pin_current_thread(const std::vector<unsigned int>& cpus)
+	{
+		if (cpus.empty())
+		{
+			return false;
+		}
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (const unsigned int cpu : cpus)
+		{
+			if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (const unsigned int cpu : cpus)
+		{
+			if (cpu < sizeof(DWORD_PTR) * 8) mask |= DWORD_PTR(1) << cpu;
+		}
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+namespace spool::detail
+{
+	constexpr size_t trace_capacity = 1 << 16;
+
+	//where a worker found the job it ran
+	constexpr size_t origin_local = SIZE_MAX;
+	constexpr size_t origin_unassigned = SIZE_MAX - 1;
+	constexpr size_t origin_mailbox = SIZE_MAX - 2;
+	constexpr size_t origin_group = SIZE_MAX - 3;
+	constexpr size_t origin_arena = SIZE_MAX - 4;
+	//run on the spot by the worker enqueuing it
+	constexpr size_t origin_inlined = SIZE_MAX - 5;
+
+	inline int64_t nanoseconds_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+	}
+
+	struct trace_event
+	{
+		const char* name;
+		int64_t begin_ns;
+		int64_t end_ns;
+		size_t origin;
+	};
+
+	//single producer (the owning worker), single consumer (whoever flushes), drops events rather than blocking when full
+	class trace_ring final
+	{
+	public:
+		trace_ring()
+			:events(new trace_event[trace_capacity])
+		{}
+
+		void record(const trace_event& event)
+		{
+			const uint64_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) >= trace_capacity)
+			{
+				dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+			events[h % trace_capacity] = event;
+			head.store(h + 1, std::memory_order_release);
+		}
+
+		//hands every recorded event to the consumer, freeing their slots
+		template<typename F>
+		void drain(F&& consume)
+		{
+			const uint64_t t = tail.load(std::memory_order_relaxed);
+			const uint64_t h = head.load(std::memory_order_acquire);
+			for (uint64_t i = t; i != h; i++)
+			{
+				consume(events[i % trace_capacity]);
+			}
+			tail.store(h, std::memory_order_release);
+		}
+
+		//events dropped for want of room since the last call, consumer only
+		uint64_t take_dropped()
+		{
+			const uint64_t total = dropped.load(std::memory_order_relaxed);
+			const uint64_t fresh = total - reported;
+			reported = total;
+			return fresh;
+		}
+
+	private:
+		std::unique_ptr<trace_event[]> events;
+		alignas(64) std::atomic_uint64_t head = 0;
+		alignas(64) std::atomic_uint64_t tail = 0;
+		std::atomic_uint64_t dropped = 0;
+		uint64_t reported = 0;
+	};
+
+	inline void write_json_string(std::ostream& out, const char* str)
+	{
+		constexpr char hex[] = "0123456789abcdef";
+		out << '"';
+		for (const char* c = str; *c != '\0'; c++)
+		{
+			const unsigned char ch = static_cast<unsigned char>(*c);
+			if (ch == '"' || ch == '\\')
+			{
+				out << '\\' << *c;
+			}
+			else if (ch < 0x20)
+			{
+				out << "\\u00" << hex[ch >> 4] << hex[ch & 0xf];
+			}
+			else
+			{
+				out << *c;
+			}
+		}
+		out << '"';
+	}
+
+	//writes one chrome trace_event "complete" event, timestamps are in microseconds
+	inline void write_trace_event(std::ostream& out, const trace_event& event, size_t worker_index)
+	{
+		out << "{\"name\":";
+		write_json_string(out, event.name != nullptr ? event.name : "job");
+		out << ",\"cat\":\"job\",\"ph\":\"X\",\"pid\":0,\"tid\":" << worker_index
+			<< ",\"ts\":" << event.begin_ns / 1000 << '.' << (event.begin_ns % 1000) / 100
+			<< ",\"dur\":" << (event.end_ns - event.begin_ns) / 1000 << '.' << ((event.end_ns - event.begin_ns) % 1000) / 100
+			<< ",\"args\":{\"origin\":";
+		if (event.origin == origin_local)
+		{
+			out << "\"local\"";
+		}
+		else if (event.origin == origin_unassigned)
+		{
+			out << "\"unassigned\"";
+		}
+		else if (event.origin == origin_mailbox)
+		{
+			out << "\"mailbox\"";
+		}
+		else if (event.origin == origin_group)
+		{
+			out << "\"group\"";
+		}
+		else if (event.origin == origin_arena)
+		{
+			out << "\"arena\"";
+		}
+		else if (event.origin == origin_inlined)
+		{
+			out << "\"inlined\"";
+		}
+		else
+		{
+			out << "\"stolen\",\"victim\":" << event.origin;
+		}
+		out << "}}";
+	}
+}
@@ -3,6 +3,9 @@
 #include <atomic>
 #include <vector>
 #include <optional>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
 #include <cassert>
 
 
@@ -80,7 +83,11 @@ while others can steal data from the queue.
                 }
 
                 Array* resize(int64_t b, int64_t t) {
-                    Array* ptr = new Array{ 2 * C };
+                    return copy(b, t, 2 * C);
+                }
+
+                Array* copy(int64_t b, int64_t t, int64_t c) {
+                    Array* ptr = new Array{ c };
                     for (int64_t i = t; i != b; ++i) {
                         ptr->push(i, pop(i));
                     }
@@ -92,7 +99,13 @@ while others can steal data from the queue.
             std::atomic<int64_t> _top;
             std::atomic<int64_t> _bottom;
             std::atomic<Array*> _array;
-            std::vector<Array*> _garbage;
+            // retired arrays, and the reclamation epoch each was retired in
+            std::vector<std::pair<Array*, uint64_t>> _garbage;
+            const std::atomic<uint64_t>* _epoch = nullptr;
+            std::atomic<int64_t> _capacity;
+            std::atomic<size_t> _retired{ 0 };
+
+            void retire(Array* a);
 
         public:
 
@@ -119,9 +132,45 @@ while others can steal data from the queue.
 
             /**
             @brief queries the capacity of the queue
+            Safe to call from any thread.
             */
             int64_t capacity() const noexcept;
 
+            /**
+            @brief sets the epoch that retired arrays are tagged with
+            Without one every array is kept until the queue is destroyed.
+            Thieves must announce the epoch they last saw between steals, and an array
+            retired in epoch e may be reclaimed once every thief has announced a later one.
+            */
+            void set_epoch(const std::atomic<uint64_t>* epoch) noexcept;
+
+            /**
+            @brief queries the number of retired arrays waiting to be reclaimed
+            Safe to call from any thread.
+            */
+            size_t retired() const noexcept;
+
+            /**
+            @brief queries the newest epoch an array waiting to be reclaimed was retired in
+            Only the owner thread can query the retired arrays, the return is 0 if there are none.
+            */
+            uint64_t newest_retired_epoch() const noexcept;
+
+            /**
+            @brief frees the retired arrays no thief can still be reading
+            Only the owner thread can reclaim.
+            @param quiescent the oldest epoch announced by any thief
+            */
+            void reclaim(uint64_t quiescent);
+
+            /**
+            @brief shrinks the queue back towards a capacity after a burst
+            Only the owner thread can shrink the queue. The old array is retired like on a resize,
+            and the queue is only shrunk if its items fit in a quarter of the current capacity.
+            @param c the capacity to shrink towards (must be power of 2)
+            */
+            void shrink(int64_t c);
+
             /**
             @brief inserts an item to the queue
             Only the owner thread can insert an item to the queue.
@@ -140,6 +189,13 @@ while others can steal data from the queue.
             */
             std::optional<T> pop();
 
+            /**
+            @brief reallocates the queue's storage from the calling thread
+            Only the owner thread can rehome the queue, and only while it is empty.
+            Used so that first-touch page placement puts the storage on the owner's NUMA node.
+            */
+            void rehome();
+
             /**
             @brief steals an item from the queue
             Any threads can try to steal an item from the queue.
@@ -155,18 +211,28 @@ while others can steal data from the queue.
             _top.store(0, std::memory_order_relaxed);
             _bottom.store(0, std::memory_order_relaxed);
             _array.store(new Array{ c }, std::memory_order_relaxed);
+            _capacity.store(c, std::memory_order_relaxed);
             _garbage.reserve(32);
         }
 
         // Destructor
         template <typename T>
         WorkStealingQueue<T>::~WorkStealingQueue() {
-            for (auto a : _garbage) {
+            for (auto& [a, epoch] : _garbage) {
                 delete a;
             }
             delete _array.load();
         }
 
+        // Procedure: retire
+        template <typename T>
+        void WorkStealingQueue<T>::retire(Array* a) {
+            // read after the new array is published, so any thief that announced this epoch or later can only see the new one
+            const uint64_t epoch = _epoch == nullptr ? UINT64_MAX : _epoch->load(std::memory_order_seq_cst);
+            _garbage.emplace_back(a, epoch);
+            _retired.store(_garbage.size(), std::memory_order_relaxed);
+        }
+
         // Function: empty
         template <typename T>
         bool WorkStealingQueue<T>::empty() const noexcept {
@@ -194,9 +260,10 @@ while others can steal data from the queue.
             // queue is full
             if (a->capacity() - 1 < (b - t)) {
                 Array* tmp = a->resize(b, t);
-                _garbage.push_back(a);
                 std::swap(a, tmp);
-                _array.store(a, std::memory_order_relaxed);
+                _array.store(a, std::memory_order_seq_cst);
+                _capacity.store(a->capacity(), std::memory_order_relaxed);
+                retire(tmp);
             }
 
             a->push(b, std::forward<O>(o));
@@ -256,10 +323,73 @@ while others can steal data from the queue.
             return item;
         }
 
+        // Function: rehome
+        template <typename T>
+        void WorkStealingQueue<T>::rehome() {
+            assert(empty());
+            Array* old = _array.load(std::memory_order_relaxed);
+            _array.store(new Array{ old->capacity() }, std::memory_order_seq_cst);
+            // a thief that saw the queue non-empty a moment ago may still be reading it
+            retire(old);
+        }
+
         // Function: capacity
         template <typename T>
         int64_t WorkStealingQueue<T>::capacity() const noexcept {
-            return _array.load(std::memory_order_relaxed)->capacity();
+            return _capacity.load(std::memory_order_relaxed);
+        }
+
+        // Function: set_epoch
+        template <typename T>
+        void WorkStealingQueue<T>::set_epoch(const std::atomic<uint64_t>* epoch) noexcept {
+            _epoch = epoch;
+        }
+
+        // Function: retired
+        template <typename T>
+        size_t WorkStealingQueue<T>::retired() const noexcept {
+            return _retired.load(std::memory_order_relaxed);
+        }
+
+        // Function: newest_retired_epoch
+        template <typename T>
+        uint64_t WorkStealingQueue<T>::newest_retired_epoch() const noexcept {
+            return _garbage.empty() ? 0 : _garbage.back().second;
+        }
+
+        // Function: reclaim
+        template <typename T>
+        void WorkStealingQueue<T>::reclaim(uint64_t quiescent) {
+            // arrays are retired in epoch order, so everything reclaimable is at the front
+            auto end = std::find_if(_garbage.begin(), _garbage.end(), [&](const auto& g) { return g.second >= quiescent; });
+            for (auto it = _garbage.begin(); it != end; ++it) {
+                delete it->first;
+            }
+            _garbage.erase(_garbage.begin(), end);
+            _retired.store(_garbage.size(), std::memory_order_relaxed);
+        }
+
+        // Function: shrink
+        template <typename T>
+        void WorkStealingQueue<T>::shrink(int64_t c) {
+            assert(c && (!(c & (c - 1))));
+            Array* a = _array.load(std::memory_order_relaxed);
+            int64_t b = _bottom.load(std::memory_order_relaxed);
+            int64_t t = _top.load(std::memory_order_acquire);
+            if (a->capacity() <= c || (b - t) * 4 > a->capacity()) {
+                return;
+            }
+            // halve at most down to the target while the items still fit with room to spare
+            int64_t target = a->capacity();
+            while (target > c && (b - t) * 4 <= target) {
+                target /= 2;
+            }
+            target = std::max(target, c);
+            Array* tmp = a->copy(b, t, target);
+            std::swap(a, tmp);
+            _array.store(a, std::memory_order_seq_cst);
+            _capacity.store(a->capacity(), std::memory_order_relaxed);
+            retire(tmp);
         }
 
     }
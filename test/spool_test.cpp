@@ -2,6 +2,17 @@
 #include <spool.h>
 #include <array>
 #include <unordered_map>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <filesystem>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <fstream>
+#ifdef SPOOL_HAS_FILE_IO
+#include <fcntl.h>
+#endif
 
 TEST(spool_test, StartsAndQuitsSafely)
 {
@@ -270,3 +281,1105 @@ TEST(spool_test, AttachThread)
 	ASSERT_EQ(res, spool::attach_result::attached_and_ran) << "failed to attach worker";
 	ASSERT_TRUE(ran.test()) << "didn't run in attached worker";
 }
+
+TEST(spool_test, Pipeline)
+{
+	spool::thread_pool pool;
+	constexpr int count = 1000;
+	constexpr int max_in_flight = 4;
+
+	int next = 0;
+	std::atomic_int in_flight = 0;
+	std::atomic_flag over_limit;
+	std::vector<int> out;
+
+	spool::pipeline<int> line(max_in_flight, [&](int& i)
+		{
+			if (next == count) return false;
+			i = next++;
+			if (++in_flight > max_in_flight) over_limit.test_and_set();
+			return true;
+		});
+	line.add_stage(spool::stage_mode::parallel, [](int& i) {i *= 2; })
+		.add_stage(spool::stage_mode::serial_in_order, [&](int& i) {out.push_back(i); in_flight--; });
+
+	auto done = line.run(pool);
+	while (!done->is_done())
+	{
+	}
+
+	ASSERT_EQ(out.size(), count) << "Not every token made it through the pipeline";
+	for (int i = 0; i < count; i++)
+	{
+		ASSERT_EQ(out[i], i * 2) << "Serial in-order stage saw tokens out of order";
+	}
+	ASSERT_FALSE(over_limit.test()) << "More tokens were in flight than the pipeline allows";
+}
+
+TEST(spool_test, Stats)
+{
+	spool::thread_pool pool(2);
+	const auto before = pool.stats();
+	ASSERT_EQ(before.workers.size(), 2) << "Stats should report every worker";
+
+	std::vector<std::shared_ptr<spool::job>> jobs;
+	for (int i = 0; i < 100; i++)
+	{
+		jobs.push_back(pool.enqueue_job([]() {}));
+	}
+	auto all_done = pool.enqueue_job([]() {}, jobs);
+	while (!all_done->is_done())
+	{
+	}
+
+	//a job is marked done just before its worker counts it, so give the last count a moment to land
+	auto delta = (pool.stats() - before).total();
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (delta.jobs_executed < 101 && end > std::chrono::system_clock::now())
+	{
+		delta = (pool.stats() - before).total();
+	}
+#ifndef SPOOL_DISABLE_STATS
+	ASSERT_GE(delta.jobs_executed, 101) << "Not every executed job was counted";
+	ASSERT_GE(delta.unassigned_pops, 101) << "Externally submitted jobs should come off the unassigned queue";
+	ASSERT_LE(delta.steals, delta.steal_attempts) << "More steals succeeded than were attempted";
+#else
+	ASSERT_EQ(delta.jobs_executed, 0);
+#endif
+}
+
+TEST(spool_test, TraceExport)
+{
+	spool::thread_pool pool(2);
+	pool.start_trace();
+	auto first = pool.enqueue_job([]() {}, { .name = "first \"job\"" });
+	auto second = pool.enqueue_job([]() {}, first, { .name = "second" });
+	while (!second->is_done())
+	{
+	}
+	//the worker records a job just after marking it done
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	pool.stop_trace();
+
+	std::ostringstream out;
+	pool.write_trace(out);
+	const std::string trace = out.str();
+	EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0) << "Trace isn't in chrome trace_event format";
+	EXPECT_NE(trace.find("\"first \\\"job\\\"\""), std::string::npos) << "Job name missing or not escaped";
+	EXPECT_NE(trace.find("\"second\""), std::string::npos) << "Dependant job missing from trace";
+	EXPECT_NE(trace.find("\"ph\":\"X\""), std::string::npos) << "No complete events were written";
+	EXPECT_NE(trace.find("\"otherData\":{\"dropped_events\":0}"), std::string::npos) << "Dropped event count missing from the trace";
+
+	std::ostringstream flushed;
+	pool.write_trace(flushed);
+	EXPECT_EQ(flushed.str().find("\"second\""), std::string::npos) << "Writing a trace should flush what was recorded";
+
+	//a full ring drops events rather than blocking, and each drop is reported once
+	spool::detail::trace_ring ring;
+	for (size_t i = 0; i < spool::detail::trace_capacity + 3; i++)
+	{
+		ring.record({ "event", 0, 0, spool::detail::origin_local });
+	}
+	EXPECT_EQ(ring.take_dropped(), 3);
+	EXPECT_EQ(ring.take_dropped(), 0);
+}
+
+TEST(spool_test, LatencyHistograms)
+{
+	spool::thread_pool pool(2);
+	const auto before = pool.latency();
+	//off by default, so this one isn't recorded
+	pool.enqueue_job([]() {})->wait();
+	pool.start_latency();
+
+	auto slow = pool.enqueue_job([]() {std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+	auto after = pool.enqueue_job([]() {}, slow);
+	while (!after->is_done())
+	{
+	}
+
+	auto latency = (pool.latency() - before).total();
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (latency.run_time.count() < 2 && end > std::chrono::system_clock::now())
+	{
+		latency = (pool.latency() - before).total();
+	}
+#if !defined(SPOOL_DISABLE_STATS) && !defined(SPOOL_DISABLE_LATENCY)
+	ASSERT_EQ(latency.run_time.count(), 2) << "Every completed job should be recorded once";
+	ASSERT_EQ(latency.queue_delay.count(), 2);
+	ASSERT_EQ(latency.blocked.count(), 2);
+	ASSERT_GE(latency.run_time.max(), std::chrono::milliseconds(20)) << "Run time histogram lost the slow job";
+	ASSERT_LE(latency.run_time.percentile(0.5), latency.run_time.max());
+#endif
+
+	spool::latency_histogram h;
+	for (int i = 1; i <= 1000; i++)
+	{
+		h.record(std::chrono::microseconds(i));
+	}
+	//buckets are accurate to within an eighth of their magnitude
+	ASSERT_NEAR(h.percentile(0.5).count(), 500'000, 500'000 / 8);
+	ASSERT_NEAR(h.percentile(0.99).count(), 990'000, 990'000 / 8);
+	ASSERT_EQ(h.mean(), std::chrono::nanoseconds(500'500));
+}
+
+TEST(spool_test, WorkerPlacement)
+{
+	spool::pool_options options;
+	options.thread_count = 2;
+	options.placement = spool::worker_placement::spread;
+	spool::thread_pool pool(options);
+	ASSERT_GE(pool.nodes(), 1) << "A placed pool should see at least one node";
+
+	std::vector<std::shared_ptr<spool::job>> jobs;
+	std::atomic_int ran = 0;
+	for (size_t node = 0; node < pool.nodes() * 2; node++)
+	{
+		jobs.push_back(pool.enqueue_job([&]() {ran++; }, { .node = node }));
+	}
+	auto all_done = pool.enqueue_job([]() {}, jobs);
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (!all_done->is_done() && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(all_done->is_done()) << "Node targeted jobs never ran";
+	ASSERT_EQ(ran.load(), pool.nodes() * 2);
+
+#ifdef __linux__
+	//pin a single worker to the first cpu we're allowed on, and check it stays there
+	cpu_set_t allowed;
+	ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+	unsigned int cpu = 0;
+	while (!CPU_ISSET(cpu, &allowed)) cpu++;
+
+	spool::pool_options pinned;
+	pinned.thread_count = 1;
+	pinned.cpu_sets = { { cpu } };
+	spool::thread_pool pinned_pool(pinned);
+	std::atomic_int seen_cpu = -1;
+	auto job = pinned_pool.enqueue_job([&]() {seen_cpu = sched_getcpu(); });
+	while (!job->is_done())
+	{
+	}
+	ASSERT_EQ(seen_cpu.load(), static_cast<int>(cpu)) << "Pinned worker ran on the wrong cpu";
+#endif
+}
+
+TEST(spool_test, ElasticPool)
+{
+	spool::pool_options options;
+	options.thread_count = 1;
+	options.min_threads = 1;
+	options.max_threads = 3;
+	options.idle_timeout = std::chrono::milliseconds(50);
+	options.grow_backlog = 4;
+	spool::thread_pool pool(options);
+	ASSERT_EQ(pool.thread_count(), 1);
+
+	//a backlog of slow jobs with nobody idle should bring in more workers
+	std::atomic_int ran = 0;
+	std::atomic_uint most_threads = 0;
+	std::vector<std::shared_ptr<spool::job>> jobs;
+	for (int i = 0; i < 40; i++)
+	{
+		jobs.push_back(pool.enqueue_job([&]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				unsigned int seen = most_threads.load();
+				while (seen < pool.thread_count() && !most_threads.compare_exchange_weak(seen, pool.thread_count())) {}
+				ran++;
+			}));
+	}
+	auto all_done = pool.enqueue_job([]() {}, jobs);
+	while (!all_done->is_done())
+	{
+	}
+	ASSERT_EQ(ran.load(), 40);
+	ASSERT_GT(most_threads.load(), 1) << "Pool never grew under a backlog";
+	ASSERT_LE(most_threads.load(), 3) << "Pool grew beyond its maximum";
+
+	//and once it's quiet, the extra workers should retire
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (pool.thread_count() > 1 && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	ASSERT_EQ(pool.thread_count(), 1) << "Idle workers never retired";
+
+	ASSERT_EQ(pool.resize(10), 3) << "Resize should clamp to the pool's bounds";
+	ASSERT_EQ(pool.thread_count(), 3);
+	ASSERT_EQ(pool.resize(1), 1);
+
+	//work still gets done after shrinking
+	auto after = pool.enqueue_job([]() {});
+	end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (!after->is_done() && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(after->is_done()) << "Work stopped after the pool shrank";
+}
+
+TEST(spool_test, Affinity)
+{
+	spool::pool_options options;
+	options.thread_count = 4;
+	options.worker_groups = { { "io", { 2, 3 } } };
+	spool::thread_pool pool(options);
+	const size_t io = pool.group("io");
+	ASSERT_EQ(io, 0);
+	ASSERT_EQ(pool.group("missing"), spool::no_group);
+
+	//pinned jobs only ever run on their worker, group jobs only on members
+	std::atomic_int wrong_worker = 0;
+	std::atomic_int wrong_group = 0;
+	std::vector<std::shared_ptr<spool::job>> jobs;
+	for (int i = 0; i < 200; i++)
+	{
+		const size_t target = i % 4;
+		jobs.push_back(pool.enqueue_job([&, target]()
+			{
+				if (spool::thread_pool::get_execution_context().runner_index != target) wrong_worker++;
+			}, { .worker = target }));
+		jobs.push_back(pool.enqueue_job([&]()
+			{
+				const size_t runner = spool::thread_pool::get_execution_context().runner_index;
+				if (runner != 2 && runner != 3) wrong_group++;
+			}, { .group = io }));
+	}
+
+	//children pinned from inside a job land back on the same worker
+	std::atomic_bool child_moved = false;
+	jobs.push_back(pool.enqueue_job([&]()
+		{
+			const auto context = spool::thread_pool::get_execution_context();
+			context.pool->enqueue_job([&, runner = context.runner_index]()
+				{
+					if (spool::thread_pool::get_execution_context().runner_index != runner) child_moved = true;
+				}, { .worker = context.runner_index });
+		}));
+
+	auto all_done = pool.enqueue_job([]() {}, jobs);
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(5);
+	while (!all_done->is_done() && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(all_done->is_done()) << "Pinned jobs never ran";
+	ASSERT_EQ(wrong_worker.load(), 0) << "Pinned jobs ran on the wrong worker";
+	ASSERT_EQ(wrong_group.load(), 0) << "Group jobs ran outside their group";
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	ASSERT_FALSE(child_moved.load()) << "Pinned child ran on a different worker";
+}
+
+TEST(spool_test, MailboxOverflow)
+{
+	spool::pool_options options;
+	options.thread_count = 2;
+	options.worker_groups = { { "solo", { 1 } } };
+	spool::thread_pool pool(options);
+	const size_t solo = pool.group("solo");
+
+	//the group's only member fills its own group's queue, and pins more jobs than fit into the other worker's mailbox
+	constexpr int count = 3000;
+	std::atomic_int group_ran = 0;
+	std::atomic_int pinned_ran = 0;
+	std::atomic_int wrong_worker = 0;
+	pool.enqueue_job([&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				pool.enqueue_job([&]()
+					{
+						if (spool::thread_pool::get_execution_context().runner_index != 1) wrong_worker++;
+						group_ran++;
+					}, { .group = solo });
+				pool.enqueue_job([&]()
+					{
+						if (spool::thread_pool::get_execution_context().runner_index != 0) wrong_worker++;
+						pinned_ran++;
+					}, { .worker = 0 });
+			}
+		}, { .group = solo });
+
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(10);
+	while ((group_ran.load() < count || pinned_ran.load() < count) && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::yield();
+	}
+	ASSERT_EQ(group_ran.load(), count) << "Group jobs were lost or deadlocked";
+	ASSERT_EQ(pinned_ran.load(), count) << "Pinned jobs were lost or deadlocked";
+	ASSERT_EQ(wrong_worker.load(), 0);
+}
+
+TEST(spool_test, Arenas)
+{
+	spool::thread_pool pool(4);
+	spool::arena& capped = pool.create_arena({ .name = "capped", .max_concurrency = 1 });
+	spool::arena& heavy = pool.create_arena({ .name = "heavy", .weight = 4 });
+
+	//a concurrency cap of one means the arena's jobs never overlap, even across workers
+	std::atomic_int inside = 0;
+	std::atomic_bool overlapped = false;
+	std::atomic_int capped_ran = 0;
+	std::atomic_int heavy_ran = 0;
+	for (int i = 0; i < 50; i++)
+	{
+		pool.enqueue_job([&]()
+			{
+				if (inside.fetch_add(1) != 0) overlapped = true;
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				inside--;
+				capped_ran++;
+			}, { .arena = &capped });
+		pool.enqueue_job([&]()
+			{
+				//children inherit the arena, so waiting on the arena covers them too
+				spool::thread_pool::get_execution_context().pool->enqueue_job([&]() {heavy_ran++; });
+				heavy_ran++;
+			}, { .arena = &heavy });
+	}
+	capped.wait();
+	heavy.wait();
+	ASSERT_EQ(capped_ran.load(), 50);
+	ASSERT_EQ(heavy_ran.load(), 100) << "Waiting on an arena didn't wait for its children";
+	ASSERT_FALSE(overlapped.load()) << "Arena ran more jobs at once than its cap";
+	ASSERT_TRUE(capped.is_idle());
+
+	//cancelling drops everything queued so far, but the arena stays usable
+	std::atomic_bool release = false;
+	std::atomic_int cancelled_ran = 0;
+	pool.enqueue_job([&]() { while (!release) {} }, { .arena = &capped });
+	for (int i = 0; i < 20; i++)
+	{
+		pool.enqueue_job([&]() {cancelled_ran++; }, { .arena = &capped });
+	}
+	capped.cancel();
+	release = true;
+	capped.wait();
+	ASSERT_EQ(cancelled_ran.load(), 0) << "Cancelled arena jobs still ran";
+
+	auto after = pool.enqueue_job([]() {}, { .arena = &capped });
+	capped.wait();
+	ASSERT_TRUE(after->is_done()) << "Arena stopped working after a cancel";
+}
+
+TEST(spool_test, ArenaOverflow)
+{
+	spool::thread_pool pool(1);
+	spool::arena& capped = pool.create_arena({ .name = "capped", .max_concurrency = 1 });
+
+	//the parent holds the arena's only slot, and the only worker, while forking more children than its queue holds, they inherit the arena
+	constexpr int count = int(spool::detail::max_arena_jobs) + 500;
+	std::atomic_int ran = 0;
+	pool.enqueue_job([&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				pool.enqueue_job([&]() {ran++; });
+			}
+		}, { .arena = &capped });
+
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(20);
+	while (ran.load() < count && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::yield();
+	}
+	ASSERT_EQ(ran.load(), count) << "Arena children were lost or deadlocked";
+}
+
+TEST(spool_test, Cancellation)
+{
+	spool::thread_pool pool(4);
+
+	//a cancelled job's dependants are cancelled rather than run on its missing output
+	std::atomic_bool gate = false;
+	std::atomic_int ran = 0;
+	auto blocker = pool.enqueue_job([&]() { while (!gate) {} });
+	auto first = pool.enqueue_job([&]() {ran++; }, blocker);
+	auto second = pool.enqueue_job([&]() {ran++; }, first);
+	first->cancel();
+	gate = true;
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (!second->is_done() && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(second->is_done());
+	ASSERT_TRUE(second->is_cancelled()) << "Dependant of a cancelled job wasn't cancelled";
+	ASSERT_EQ(ran.load(), 0);
+	ASSERT_FALSE(blocker->is_cancelled());
+
+	//a token reaches running jobs, their children, and anything queued
+	spool::cancellation_token token = spool::cancellation_token::create();
+	std::atomic_bool saw_cancel = false;
+	std::atomic_bool started = false;
+	std::atomic_int children_ran = 0;
+	auto running = pool.enqueue_job([&]()
+		{
+			started = true;
+			while (!token.is_cancelled()) {}
+			saw_cancel = true;
+			//enqueued after the cancel, inherits the token so never runs
+			spool::thread_pool::get_execution_context().pool->enqueue_job([&]() {children_ran++; });
+		}, { .cancellation = token });
+	auto queued = pool.enqueue_job([&]() {ran++; }, running, { .cancellation = token });
+	while (!started) {}
+	token.cancel();
+	end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (!(queued->is_done() && running->is_done()) && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(saw_cancel.load()) << "Running job never saw its token cancelled";
+	ASSERT_TRUE(queued->is_cancelled());
+	ASSERT_EQ(ran.load(), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	ASSERT_EQ(children_ran.load(), 0) << "Child of a cancelled job ran";
+
+	//a job that was already running when its token was cancelled still finishes, and so its dependants run
+	spool::cancellation_token late_token = spool::cancellation_token::create();
+	std::atomic_bool late_started = false;
+	std::atomic_bool late_gate = false;
+	auto unaware = pool.enqueue_job([&]()
+		{
+			late_started = true;
+			//carries on regardless of the cancel
+			while (!late_gate) {}
+		}, { .cancellation = late_token });
+	std::atomic_bool dependant_ran = false;
+	while (!late_started) {}
+	late_token.cancel();
+	//tried while its prerequisite is still running
+	auto after = pool.enqueue_job([&]() {dependant_ran = true; }, unaware);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	late_gate = true;
+	end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (!after->is_done() && end > std::chrono::system_clock::now())
+	{
+	}
+	ASSERT_TRUE(unaware->is_done());
+	ASSERT_FALSE(unaware->is_cancelled());
+	ASSERT_TRUE(dependant_ran.load()) << "Dependant of a job cancelled mid-run was cancelled";
+
+	//jobs that already ran aren't affected by a later cancel
+	auto finished = pool.enqueue_job([]() {});
+	while (!finished->is_done()) {}
+	finished->cancel();
+	ASSERT_FALSE(finished->is_cancelled());
+}
+
+TEST(spool_test, Exceptions)
+{
+	spool::thread_pool pool(2);
+
+	//a throwing job fails rather than taking its worker down, and its dependants are skipped
+	std::atomic_bool dependant_ran = false;
+	auto thrower = pool.enqueue_job([]() { throw std::runtime_error("bad input"); });
+	auto dependant = pool.enqueue_job([&]() {dependant_ran = true; }, thrower);
+	auto downstream = pool.enqueue_job([]() {}, dependant);
+	ASSERT_THROW(downstream->wait(), std::runtime_error) << "Failure didn't propagate down the chain";
+	ASSERT_TRUE(thrower->is_failed());
+	ASSERT_TRUE(dependant->is_failed());
+	ASSERT_FALSE(dependant_ran.load());
+	ASSERT_EQ(dependant->get_exception(), thrower->get_exception());
+
+	//the workers carry on afterwards
+	auto fine = pool.enqueue_job([]() {});
+	ASSERT_NO_THROW(fine->wait());
+	ASSERT_FALSE(fine->is_failed());
+	ASSERT_EQ(fine->get_exception(), nullptr);
+
+	//a throwing stage stops the pipeline rather than leaving it stuck
+	int produced = 0;
+	spool::pipeline<int> p(4, [&](int& out) {out = produced++; return produced <= 100; });
+	p.add_stage(spool::stage_mode::serial_in_order, [](int& v) { if (v == 10) throw std::runtime_error("bad token"); });
+	ASSERT_THROW(p.run(pool)->wait(), std::runtime_error);
+}
+
+TEST(spool_test, Shutdown)
+{
+	{
+		spool::thread_pool pool(2);
+		//a backlog, including a chain that keeps adding work as it goes, should all be finished by a draining shutdown
+		std::atomic_int ran = 0;
+		std::atomic_bool release = false;
+		pool.enqueue_job([&]() { while (!release) {} ran++; });
+		for (int i = 0; i < 500; i++)
+		{
+			pool.enqueue_job([&]() {ran++; });
+		}
+		pool.enqueue_job([&]()
+			{
+				auto* p = spool::thread_pool::get_execution_context().pool;
+				auto child = p->enqueue_job([&]() {ran++; });
+				p->enqueue_job([&]() {ran++; }, child);
+				ran++;
+			});
+		std::thread releaser([&]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); release = true; });
+		ASSERT_EQ(pool.shutdown(), 0) << "Draining shutdown dropped jobs";
+		releaser.join();
+		ASSERT_EQ(ran.load(), 504);
+
+		//nothing more is taken once shut down
+		auto late = pool.enqueue_job([&]() {ran++; });
+		ASSERT_TRUE(late->is_cancelled()) << "Job enqueued after shutdown was accepted";
+	}
+	{
+		//work that can never finish is reported once the timeout runs out
+		spool::thread_pool pool(2);
+		auto stuck = pool.enqueue_data_job<int>([](const int&) {});
+		pool.enqueue_job([]() {}, stuck.job);
+		ASSERT_EQ(pool.shutdown(true, std::chrono::milliseconds(50)), 2);
+	}
+}
+
+TEST(spool_test, QueueReclamation)
+{
+	spool::thread_pool pool(2);
+
+	//a burst of children grows the spawning worker's queue well past its starting size
+	std::atomic_int ran = 0;
+	std::atomic_bool release = false;
+	size_t grown_capacity = 0;
+	auto burst = pool.enqueue_job([&]()
+		{
+			const auto context = spool::thread_pool::get_execution_context();
+			for (int i = 0; i < 5000; i++)
+			{
+				context.pool->enqueue_job([&]() { while (!release) std::this_thread::yield(); ran++; });
+			}
+			grown_capacity = context.pool->stats().workers[context.runner_index].queue_capacity;
+		});
+	burst->wait();
+	release = true;
+	ASSERT_GT(grown_capacity, spool::max_assigned_jobs);
+
+	//once it's drained, the queue shrinks back and every outgrown array is freed
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(5);
+	bool settled = false;
+	while (!settled && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		const auto total = pool.stats().total();
+		settled = ran == 5000 && total.retired_arrays == 0 && total.queue_capacity == 2 * spool::max_assigned_jobs;
+	}
+	ASSERT_EQ(ran.load(), 5000);
+	ASSERT_TRUE(settled) << "Queue arrays were never reclaimed after the burst";
+}
+
+TEST(spool_test, Continuations)
+{
+	spool::thread_pool pool(2);
+	const auto before = pool.stats();
+
+	//a chain built up behind a blocked head parks on its prerequisites, then runs through in order once released
+	std::atomic_bool release = false;
+	std::vector<int> order;
+	auto previous = pool.enqueue_job([&]() { while (!release) { std::this_thread::yield(); } });
+	for (int i = 0; i < 200; i++)
+	{
+		previous = pool.enqueue_job([&order, i]() {order.push_back(i); }, previous);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	release = true;
+	previous->wait();
+	ASSERT_EQ(order.size(), 200);
+	ASSERT_TRUE(std::ranges::is_sorted(order)) << "Chain ran out of order";
+#ifndef SPOOL_DISABLE_STATS
+	const auto delta = (pool.stats() - before).total();
+	ASSERT_GT(delta.jobs_parked, 0) << "Blocked jobs were never parked";
+	ASSERT_GT(delta.handoffs, 0) << "Released jobs were never handed off";
+#endif
+
+	//parked jobs still see a failure or cancellation upstream
+	std::atomic_bool fail_release = false;
+	std::atomic_bool ran = false;
+	auto thrower = pool.enqueue_job([&]() { while (!fail_release) { std::this_thread::yield(); } throw std::runtime_error("bad input"); });
+	auto failed = pool.enqueue_job([&]() {ran = true; }, thrower);
+	auto skipped = pool.enqueue_job([&]() {ran = true; }, failed);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	failed->cancel();
+	fail_release = true;
+	skipped->wait();
+	ASSERT_TRUE(failed->is_cancelled());
+	ASSERT_TRUE(skipped->is_cancelled()) << "Dependant parked on a cancelled job wasn't cancelled";
+	ASSERT_FALSE(ran.load());
+
+	auto gate = pool.enqueue_job([&]() { while (!release) { std::this_thread::yield(); } throw std::runtime_error("bad input"); });
+	auto downstream = pool.enqueue_job([&]() {ran = true; }, gate);
+	ASSERT_THROW(downstream->wait(), std::runtime_error) << "Failure didn't reach a parked dependant";
+	ASSERT_FALSE(ran.load());
+}
+
+TEST(spool_test, Inlining)
+{
+	//with a single worker nobody is ever idle to steal, so once its queue is deep tiny jobs run on the spot
+	spool::thread_pool pool({ .thread_count = 1, .inline_threshold = 16 });
+	const auto before = pool.stats();
+	const auto latency_before = pool.latency();
+	pool.start_latency();
+	pool.start_trace();
+	std::atomic_int ran = 0;
+	std::atomic_int queued_ran = 0;
+	auto parent = pool.enqueue_job([&]()
+		{
+			auto* p = spool::thread_pool::get_execution_context().pool;
+			for (int i = 0; i < 1000; i++)
+			{
+				p->enqueue_job([&]() {ran++; }, { .may_inline = true });
+			}
+			//without the hint, or with prerequisites still to wait on, jobs are always queued
+			auto plain = p->enqueue_job([&]() {queued_ran++; });
+			p->enqueue_job([&]() {queued_ran++; }, plain, { .may_inline = true });
+		});
+	parent->wait();
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while ((ran < 1000 || queued_ran < 2) && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::yield();
+	}
+	ASSERT_EQ(ran.load(), 1000);
+	ASSERT_EQ(queued_ran.load(), 2);
+#ifndef SPOOL_DISABLE_STATS
+	const auto delta = (pool.stats() - before).total();
+	ASSERT_GT(delta.jobs_inlined, 0) << "Nothing was inlined despite the deep queue";
+	ASSERT_LE(delta.jobs_inlined, 1000 - 16) << "Jobs were inlined before the queue reached the threshold";
+#endif
+
+	//inlined jobs are timed and traced like any other, the parent is recorded just after it's marked done
+	auto latency = (pool.latency() - latency_before).total();
+	end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (latency.run_time.count() < 1003 && end > std::chrono::system_clock::now())
+	{
+		latency = (pool.latency() - latency_before).total();
+	}
+#if !defined(SPOOL_DISABLE_STATS) && !defined(SPOOL_DISABLE_LATENCY)
+	ASSERT_EQ(latency.run_time.count(), 1003) << "Inlined jobs were missing from the latency histograms";
+#endif
+	pool.stop_trace();
+	std::ostringstream trace;
+	pool.write_trace(trace);
+	ASSERT_NE(trace.str().find("\"origin\":\"inlined\""), std::string::npos) << "Inlined jobs were missing from the trace";
+}
+
+TEST(spool_test, BlockingRegion)
+{
+	//the only worker blocks waiting on a job queued behind it, which only a stand-in can run
+	spool::thread_pool pool({ .thread_count = 1, .compensation_threads = 2 });
+	std::atomic_bool started = false;
+	std::atomic_bool unblocked = false;
+	auto blocked = pool.enqueue_job([&]()
+		{
+			spool::blocking_region region;
+			started = true;
+			auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+			while (!unblocked && end > std::chrono::system_clock::now())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	while (!started)
+	{
+		std::this_thread::yield();
+	}
+	ASSERT_EQ(pool.compensating_thread_count(), 1);
+	pool.enqueue_job([&]() {unblocked = true; })->wait();
+	blocked->wait();
+	ASSERT_TRUE(unblocked.load()) << "Nobody stood in for the blocked worker";
+
+	//the stand-in leaves once the blocked worker is back
+	auto end = std::chrono::system_clock::now() + std::chrono::seconds(2);
+	while (pool.compensating_thread_count() != 0 && end > std::chrono::system_clock::now())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ(pool.compensating_thread_count(), 0);
+	ASSERT_EQ(pool.thread_count(), 1);
+
+	//blocking jobs do the same for their whole run
+	std::atomic_bool released = false;
+	auto reader = pool.enqueue_blocking_job([&]() { while (!released) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); } });
+	pool.enqueue_job([&]() {released = true; })->wait();
+	reader->wait();
+
+	//outside a pool it does nothing
+	spool::blocking_region outside;
+}
+
+#ifdef SPOOL_HAS_FILE_IO
+TEST(spool_test, AsyncFileRead)
+{
+	const auto path = std::filesystem::temp_directory_path() / "spool_async_read.txt";
+	{
+		std::ofstream file(path, std::ios::binary);
+		for (int i = 0; i < 1000; i++)
+		{
+			file << i << '\n';
+		}
+	}
+	const int fd = open(path.c_str(), O_RDONLY);
+	ASSERT_GE(fd, 0);
+
+	spool::thread_pool pool(2);
+	std::vector<std::byte> head(16);
+	std::string seen;
+	auto read = pool.read_file_async(fd, 0, head, [&](const spool::file_read& result)
+		{
+			seen.assign(reinterpret_cast<const char*>(result.data.data()), result.data.size());
+		});
+	read.job->wait();
+	ASSERT_EQ(seen, std::string("0\n1\n2\n3\n4\n5\n6\n7\n", 16));
+
+	//a read running off the end of the file comes back short, and many can be in flight at once
+	const auto size = std::filesystem::file_size(path);
+	std::vector<std::vector<std::byte>> buffers(300, std::vector<std::byte>(64));
+	std::vector<spool::data_job<spool::file_read>> reads;
+	for (auto& buffer : buffers)
+	{
+		reads.push_back(pool.read_file_async(fd, size - 10, buffer));
+	}
+	for (auto& r : reads)
+	{
+		r.job->wait();
+		const auto handle = r.data->create_read_handle();
+		ASSERT_TRUE(handle.has());
+		ASSERT_EQ(handle.get().error, 0);
+		ASSERT_EQ(handle.get().data.size(), 10);
+	}
+	ASSERT_EQ(pool.reads_in_flight(), 0);
+
+	//failures are reported rather than thrown
+	std::vector<std::byte> unused(8);
+	auto failed = pool.read_file_async(-1, 0, unused);
+	failed.job->wait();
+	ASSERT_EQ(failed.data->create_read_handle().get().error, EBADF);
+
+	//a worker that never runs dry still picks up completed reads every so often
+	spool::thread_pool busy(1);
+	std::atomic_bool landed = false;
+	const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	std::function<void()> spin = [&]()
+		{
+			if (!landed && std::chrono::steady_clock::now() < give_up)
+			{
+				busy.enqueue_job(spin);
+			}
+		};
+	//issued from inside the pool, so the job waiting on it is retried on the busy worker between spins
+	busy.enqueue_job([&]()
+		{
+			busy.enqueue_job(spin);
+			auto read = busy.read_file_async(fd, 0, head, [&](const spool::file_read&) {landed = true; });
+		});
+	while (!landed && std::chrono::steady_clock::now() < give_up)
+	{
+		std::this_thread::yield();
+	}
+	ASSERT_LT(std::chrono::steady_clock::now(), give_up) << "The read only completed once the worker ran out of work";
+
+	close(fd);
+	std::filesystem::remove(path);
+}
+#endif
+
+#ifdef SPOOL_HAS_MAPPED_FILE
+TEST(spool_test, MappedFile)
+{
+	//enough lines to make several chunks, each one long enough that a cut mid-record would show
+	const auto path = std::filesystem::temp_directory_path() / "spool_mapped_file.txt";
+	const int lines = 200000;
+	{
+		std::ofstream file(path, std::ios::binary);
+		for (int i = 0; i < lines; i++)
+		{
+			file << "record " << i << " padding padding padding\n";
+		}
+	}
+
+	spool::thread_pool pool(2);
+	std::atomic_int seen = 0;
+	std::atomic_int chunks = 0;
+	std::atomic_bool whole = true;
+	auto jobs = pool.parallel_for_mapped_file(path.string(), [&](std::string_view chunk)
+		{
+			chunks++;
+			if (!chunk.starts_with("record ") || !chunk.ends_with("padding\n")) whole = false;
+			for (size_t line = chunk.find("record "); line != std::string_view::npos; line = chunk.find("record ", line + 1))
+			{
+				seen++;
+			}
+		});
+	auto all_done = pool.enqueue_job([]() {}, jobs);
+	all_done->wait();
+	ASSERT_GT(chunks.load(), 1) << "File wasn't split";
+	ASSERT_TRUE(whole.load()) << "A chunk started or ended part way through a record";
+	ASSERT_EQ(seen.load(), lines);
+
+	//a file that isn't there is an error, while an empty one is just nothing to do
+	ASSERT_THROW(pool.parallel_for_mapped_file("/nonexistent/spool", [](std::string_view) {}), std::system_error);
+	std::ofstream(path, std::ios::binary | std::ios::trunc).close();
+	ASSERT_TRUE(pool.parallel_for_mapped_file(path.string(), [](std::string_view) {}).empty());
+	std::filesystem::remove(path);
+}
+#endif
+
+TEST(spool_test, ScratchMemory)
+{
+	spool::thread_pool pool(1);
+	ASSERT_EQ(spool::thread_pool::get_execution_context().scratch, nullptr);
+
+	//memory is handed out by bumping a pointer, and reused by the next job
+	void* first = nullptr;
+	void* second = nullptr;
+	pool.enqueue_job([&]() { first = spool::thread_pool::get_execution_context().scratch->allocate<int>(100); })->wait();
+	pool.enqueue_job([&]() { second = spool::thread_pool::get_execution_context().scratch->allocate<int>(100); })->wait();
+	ASSERT_NE(first, nullptr);
+	ASSERT_EQ(first, second) << "Scratch memory wasn't reset between jobs";
+
+	//containers can grow in it past the first block, which leaves one block big enough behind so the next job doesn't have to grow
+	size_t used = 0;
+	pool.enqueue_job([&]()
+		{
+			std::pmr::vector<int> values(spool::thread_pool::get_execution_context().scratch->resource());
+			for (int i = 0; i < 100000; i++)
+			{
+				values.push_back(i);
+			}
+			used = spool::thread_pool::get_execution_context().scratch->used();
+		})->wait();
+	ASSERT_GE(used, 100000 * sizeof(int));
+	size_t capacity_before = 0;
+	size_t capacity_after = 0;
+	pool.enqueue_job([&]()
+		{
+			auto* scratch = spool::thread_pool::get_execution_context().scratch;
+			capacity_before = scratch->capacity();
+			scratch->allocate(used);
+			capacity_after = scratch->capacity();
+		})->wait();
+	ASSERT_GE(capacity_before, used);
+	ASSERT_EQ(capacity_before, capacity_after) << "Scratch memory grew again after being merged";
+}
+
+TEST(spool_test, PerWorker)
+{
+	spool::thread_pool pool(4);
+	spool::per_worker<uint64_t> sums(pool);
+	spool::per_worker<int> counts(pool, 0);
+	ASSERT_EQ(sums.size(), pool.worker_count());
+	ASSERT_EQ(pool.current_worker_index(), SIZE_MAX);
+
+	//every worker adds into its own slot, and the slots add up to the whole
+	std::vector<int> values(10000);
+	std::iota(values.begin(), values.end(), 1);
+	auto jobs = pool.for_each(values, [&](int& v)
+		{
+			sums.local() += v;
+			counts.local()++;
+		});
+	pool.enqueue_job([]() {}, jobs)->wait();
+	ASSERT_EQ(sums.combine(std::plus<>()), 10000ull * 10001 / 2);
+	int total = 0;
+	counts.for_each([&](const int& c) {total += c; });
+	ASSERT_EQ(total, 10000);
+
+	//slots never share a cache line
+	ASSERT_GE(reinterpret_cast<uintptr_t>(&sums[1]) - reinterpret_cast<uintptr_t>(&sums[0]), spool::detail::cache_line_size);
+}
+
+TEST(spool_test, ConcurrentMap)
+{
+	spool::thread_pool pool(4);
+	spool::concurrent_map<int, int> map(16);
+
+	//a parallel build lands every entry in its shard
+	std::vector<std::pair<int, int>> items;
+	for (int i = 0; i < 10000; i++)
+	{
+		items.emplace_back(i, i * 2);
+	}
+	auto built = map.build(pool, items);
+	pool.enqueue_job([]() {}, built)->wait();
+	ASSERT_EQ(map.size(), 10000);
+
+	//per key writers only hold the key's shard, so many can run at once and none are lost
+	std::vector<std::shared_ptr<spool::job>> writes;
+	for (int i = 0; i < 1000; i++)
+	{
+		writes.push_back(pool.enqueue_shared_resource_job([](int& v) {v++; }, map.create_write_provider(i % 100)));
+		writes.push_back(pool.enqueue_shared_resource_job([](int& v) {v = 1; }, map.create_write_provider(20000 + i)));
+	}
+	pool.enqueue_job([]() {}, writes)->wait();
+	ASSERT_EQ(map.shard(map.shard_of(5)).get().at(5), 10 + 10);
+	ASSERT_EQ(map.size(), 11000);
+
+	//a missing key reads as a default value
+	int read = -1;
+	pool.enqueue_shared_resource_job([&](const int& v) {read = v; }, map.create_read_provider(-5))->wait();
+	ASSERT_EQ(read, 0);
+	ASSERT_EQ(map.size(), 11000) << "Reading a missing key inserted it";
+
+	//a writer that can't run yet because its other input isn't there doesn't insert its key in the meantime
+	auto input = std::make_shared<spool::input_data<int>>();
+	auto waiting = pool.enqueue_shared_resource_job([](int& v, const int& in) {v = in; }, map.create_write_provider(-7),
+		spool::read_provider<int, spool::input_data<int>, std::shared_ptr<spool::input_data<int>>>(input));
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	ASSERT_EQ(map.size(), 11000) << "A writer that never ran inserted its key";
+	input->submit(3);
+	waiting->wait();
+	ASSERT_EQ(map.shard(map.shard_of(-7)).get().at(-7), 3);
+	map.shard(map.shard_of(-7)).get().erase(-7);
+
+	//iteration visits every entry once
+	std::atomic_int visited = 0;
+	std::atomic<int64_t> sum = 0;
+	auto iterated = map.for_each(pool, [&](const int& k, const int& v) {visited++; if (k < 10000) sum += v; });
+	pool.enqueue_job([]() {}, iterated)->wait();
+	ASSERT_EQ(visited.load(), 11000);
+	ASSERT_EQ(sum.load(), int64_t(9999) * 10000 + 1000);
+}
+
+TEST(spool_test, ParallelSort)
+{
+	spool::thread_pool pool(4);
+	std::mt19937 random(42);
+
+	//big enough to be split into pieces and merged over several levels
+	std::vector<int> values(1 << 20);
+	for (auto& v : values)
+	{
+		v = static_cast<int>(random() % 100000);
+	}
+	std::vector<int> expected = values;
+	std::ranges::sort(expected);
+	pool.parallel_sort(values)->wait();
+	ASSERT_EQ(values, expected);
+
+	//a custom comparison, and small ranges sorted serially
+	pool.parallel_sort(values, std::greater<>())->wait();
+	ASSERT_TRUE(std::ranges::is_sorted(values, std::greater<>()));
+	std::vector<int> small{ 5, 3, 9, 1 };
+	pool.parallel_sort(small)->wait();
+	ASSERT_EQ(small, (std::vector<int>{ 1, 3, 5, 9 }));
+
+	//the stable variant keeps equal keys in their original order, with elements that aren't cheap to copy
+	std::vector<std::pair<int, std::string>> records(300000);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		records[i] = { static_cast<int>(random() % 100), std::to_string(i) };
+	}
+	pool.parallel_stable_sort(records, [](const auto& a, const auto& b) {return a.first < b.first; })->wait();
+	for (size_t i = 1; i < records.size(); i++)
+	{
+		ASSERT_LE(records[i - 1].first, records[i].first);
+		if (records[i - 1].first == records[i].first)
+		{
+			ASSERT_LT(std::stoul(records[i - 1].second), std::stoul(records[i].second)) << "Equal keys were reordered";
+		}
+	}
+
+	//a range too small to split into two pieces gets no buffer, so nothing is default constructed for one
+	static std::atomic_int constructed;
+	struct counted
+	{
+		counted() { constructed++; }
+		counted(int v) : v(v) {}
+		auto operator<=>(const counted& other) const { return v <=> other.v; }
+		bool operator==(const counted& other) const { return v == other.v; }
+		int v = 0;
+	};
+	std::vector<counted> one_piece;
+	for (int i = 0; i < 20000; i++)
+	{
+		one_piece.emplace_back(static_cast<int>(random() % 1000));
+	}
+	constructed = 0;
+	pool.parallel_sort(one_piece)->wait();
+	ASSERT_TRUE(std::ranges::is_sorted(one_piece));
+	ASSERT_EQ(constructed.load(), 0) << "Allocated a buffer it never used";
+
+	//elements that can't be default constructed still sort, just in one job
+	struct no_default
+	{
+		explicit no_default(int v) : v(v) {}
+		auto operator<=>(const no_default& other) const { return v <=> other.v; }
+		bool operator==(const no_default& other) const { return v == other.v; }
+		int v;
+	};
+	std::vector<no_default> fixed;
+	for (int i = 0; i < 100000; i++)
+	{
+		fixed.emplace_back(static_cast<int>(random() % 1000));
+	}
+	pool.parallel_stable_sort(fixed)->wait();
+	ASSERT_TRUE(std::ranges::is_sorted(fixed));
+}
+
+TEST(spool_test, ParallelSearch)
+{
+	spool::thread_pool pool(4);
+	std::vector<int> values(1 << 20);
+	std::iota(values.begin(), values.end(), 0);
+
+	//the lowest index match, even though chunks further on match too
+	auto found = pool.parallel_find_if(values, [](int v) {return v % 300000 == 299999; });
+	found.job->wait();
+	ASSERT_EQ(found.data->create_read_handle().get(), 299999);
+	auto missing = pool.parallel_find_if(values, [](int v) {return v < 0; });
+	missing.job->wait();
+	ASSERT_EQ(missing.data->create_read_handle().get(), values.size());
+
+	std::atomic_bool any = false;
+	pool.parallel_any_of(values, [](int v) {return v == 1000000; }, [&](const bool& result) {any = result; }).job->wait();
+	ASSERT_TRUE(any);
+	std::vector<int> empty;
+	auto none = pool.parallel_any_of(empty, [](int) {return true; });
+	none.job->wait();
+	ASSERT_FALSE(none.data->create_read_handle().get());
+
+	//once everything matches, chunks stop at their first grain and most never start at all
+	std::atomic_size_t calls = 0;
+	auto early = pool.parallel_any_of(values, [&](int) {calls++; return true; });
+	early.job->wait();
+	ASSERT_TRUE(early.data->create_read_handle().get());
+	ASSERT_LT(calls.load(), values.size() / 2) << "Search didn't stop early";
+
+	//a throwing predicate fails the search
+	auto failing = pool.parallel_find_if(values, [](int v) {if (v == 5000) throw std::runtime_error("failed"); return false; });
+	ASSERT_THROW(failing.job->wait(), std::runtime_error);
+}
+
+TEST(spool_test, ExecutionPolicy)
+{
+	spool::thread_pool pool(4);
+	auto par = spool::execution::par(pool);
+	std::vector<int> values(100000);
+	std::iota(values.begin(), values.end(), 0);
+
+	std::vector<int> doubled(values.size());
+	ASSERT_EQ(spool::transform(par, values.begin(), values.end(), doubled.begin(), [](int v) {return v * 2; }), doubled.end());
+	ASSERT_EQ(doubled[12345], 24690);
+
+	std::atomic_int64_t sum = 0;
+	spool::for_each(par, values.begin(), values.end(), [&](int v) {sum.fetch_add(v); });
+	ASSERT_EQ(sum.load(), int64_t(99999) * 100000 / 2);
+
+	//copy_if keeps the input order across chunks
+	std::vector<int> evens(values.size());
+	auto end = spool::copy_if(par, values.begin(), values.end(), evens.begin(), [](int v) {return v % 2 == 0; });
+	ASSERT_EQ(end - evens.begin(), 50000);
+	ASSERT_TRUE(std::is_sorted(evens.begin(), end));
+	ASSERT_EQ(spool::count_if(par, values.begin(), values.end(), [](int v) {return v % 3 == 0; }), 33334);
+
+	//find_if finds the first match even when later chunks have matches too
+	ASSERT_EQ(*spool::find_if(par, values.begin(), values.end(), [](int v) {return v >= 70000 || v == 30000; }), 30000);
+	ASSERT_EQ(spool::find_if(par, values.begin(), values.end(), [](int v) {return v < 0; }), values.end());
+	ASSERT_TRUE(spool::any_of(par, values.begin(), values.end(), [](int v) {return v == 99999; }));
+	ASSERT_TRUE(spool::all_of(par, values.begin(), values.end(), [](int v) {return v >= 0; }));
+	ASSERT_TRUE(spool::none_of(par, values.begin(), values.end(), [](int v) {return v > 99999; }));
+
+	//from inside one of the pool's own jobs it runs in place instead of waiting on the pool
+	std::atomic_bool found = false;
+	pool.enqueue_job([&]() {found = spool::any_of(par, values.begin(), values.end(), [](int v) {return v == 5; }); })->wait();
+	ASSERT_TRUE(found);
+
+	//failures are passed on once every chunk has stopped
+	ASSERT_THROW(spool::for_each(par, values.begin(), values.end(), [](int v) {if (v == 500) throw std::runtime_error("failed"); }), std::runtime_error);
+}